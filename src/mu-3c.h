@@ -0,0 +1,65 @@
+/******************************************************************************/
+/* THREE-C MISS CLASSIFICATION                                                */
+/******************************************************************************/
+/* Every demand access in MEM() also goes to a fully-associative LRU shadow  */
+/* cache with as many blocks as L1Cache, and marks its block in a bitmap of */
+/* blocks ever touched. An L1 miss is then:                                  */
+/*   compulsory - first touch of the block                                   */
+/*   capacity   - the shadow cache misses too                                */
+/*   conflict   - the shadow cache hits, only the mapping lost it            */
+/* Counts are kept per PC and per data region. Pipeline only, core 0 only.  */
+/******************************************************************************/
+#define MISS_COMPULSORY 0
+#define MISS_CAPACITY 1
+#define MISS_CONFLICT 2
+#define MISS_CLASSES 3
+
+#define SEEN_PAGE_SHIFT 12 //one 256-bit bitmap (a 4KB page of blocks) allocated per touched page
+#define SEEN_NUM_PAGES (1 << (32 - SEEN_PAGE_SHIFT))
+#define SEEN_PAGE_BYTES ((1 << SEEN_PAGE_SHIFT) / (WORD_PER_BLOCK * 4) / 8)
+
+/* data regions the misses are broken down by */
+#define REGION_DATA 0  //static data, MEM_DATA_BEGIN up to the heap
+#define REGION_HEAP 1  //sbrk memory
+#define REGION_STACK 2 //top of the user address space
+#define REGION_OTHER 3
+#define NUM_REGIONS 4
+#define STACK_REGION_BEGIN 0x70000000
+
+#define MISS_TOP_PCS 10 //rows in the per-PC report
+
+typedef struct Shadow_Block_Struct {
+
+  int valid;
+  uint32_t blockAddress;
+  uint32_t lastUse; //access number, for LRU
+
+} Shadow_Block;
+
+/***************************************************************/
+/* CLASSIFIER STATE                                            */
+/***************************************************************/
+int CLASSIFY_MISSES = FALSE;
+uint8_t **SEEN_PAGES; //NULL until a block in the page is touched
+Shadow_Block SHADOW_CACHE[NUM_CACHE_BLOCKS];
+uint32_t shadowClock;
+int missFirstTouch, missShadowHit; //outcome for the access cache_access() is looking at
+uint32_t (*MISS_BY_PC)[MISS_CLASSES]; //PROGRAM_SIZE rows, indexed like the profiler
+uint32_t MISS_BY_PC_SIZE;
+
+/***************************************************************/
+/* CLASSIFIER STATS                                            */
+/***************************************************************/
+uint32_t MISS_CLASS[MISS_CLASSES];
+uint32_t MISS_BY_REGION[NUM_REGIONS][MISS_CLASSES];
+
+/***************************************************************/
+/* Classifier Function Declerations.                           */
+/***************************************************************/
+void classify_access(uint32_t);
+void classify_miss(uint32_t, uint32_t);
+int miss_region(uint32_t);
+void classify_reset();
+void set_classify_misses(int);
+int miss_pc_compare(const void *, const void *);
+void print_miss_classes();
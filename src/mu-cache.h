@@ -3,38 +3,201 @@
 /******************************************************************************/
 #define NUM_CACHE_BLOCKS 16
 #define WORD_PER_BLOCK 4
+#define CACHE_MISS_PENALTY 100 //cycles to bring a block in from memory
+#define MIN_VICTIM_ENTRIES 2
+#define MAX_VICTIM_ENTRIES 16
+#define MAX_STORE_BUFFER 16
+
+/* MESI coherence states */
+#define MESI_INVALID 0
+#define MESI_SHARED 1
+#define MESI_EXCLUSIVE 2
+#define MESI_MODIFIED 3
+
+/* address = | tag (24) | index (4) | word offset (2) | byte offset (2) | */
+#define CACHE_WORD_OFFSET(addr) (((addr) & 0x0000000C) >> 2)
+#define CACHE_INDEX(addr) (((addr) & 0x000000F0) >> 4)
+#define CACHE_TAG(addr) (((addr) & 0xFFFFFF00) >> 8)
+#define CACHE_BLOCK_ADDRESS(addr) ((addr) & 0xFFFFFFF0)
+#define CACHE_ADDRESS(tag, index) (((tag) << 8) | ((index) << 4))
 
 
 typedef struct CacheBlock_Struct {
 
   int valid; //indicates if the given block contains a valid data. Initially, this is 0
+  int state; //MESI state, only matters when several cores share memory
+  int prefetched; //brought in by the prefetcher and not used by a demand access yet
   uint32_t tag; //this field should contain the tag, i.e. the high-order 32 - (2+2+4)  = 24 bits
   uint32_t words[WORD_PER_BLOCK]; //this is where actual data is stored. Each word is 4-byte long, and each cache block contains 4 blocks.
   
   
 } CacheBlock;
 
+/***************************************************************/
+/* WAY LOOKUP                                                  */
+/***************************************************************/
+/* Associative structures keep their tags as a structure of arrays: tags    */
+/* and valid masks (0 or 0xFFFFFFFF) in separate aligned arrays, so         */
+/* tag_match() compares 8 (AVX2) or 4 (SSE2) ways per instruction and masks */
+/* out invalid ones in the same step. Builds without either fall back to    */
+/* the scalar loop. "waybench" compares the two.                            */
+/***************************************************************/
+#define MAX_WAYS 256
+
+#if defined(__AVX2__)
+#define WAY_LOOKUP_KERNEL "AVX2"
+#elif defined(__SSE2__)
+#define WAY_LOOKUP_KERNEL "SSE2"
+#else
+#define WAY_LOOKUP_KERNEL "scalar"
+#endif
+
+typedef struct TagStore_Struct {
+
+  uint32_t tags[MAX_WAYS] __attribute__((aligned(32)));
+  uint32_t valid[MAX_WAYS] __attribute__((aligned(32))); //all ones = valid, so it can mask a compare
+
+} TagStore;
+
+/***************************************************************/
+/* Way Lookup Function Declerations.                           */
+/***************************************************************/
+int tag_match(const uint32_t *, const uint32_t *, int, uint32_t);
+int tag_match_scalar(const uint32_t *, const uint32_t *, int, uint32_t);
+void way_benchmark();
+
+typedef struct VictimBlock_Struct {
+
+  CacheBlock block;
+  uint32_t lastUse; //cycle it was evicted into the buffer or last checked, for LRU
+
+} VictimBlock;
+
 typedef struct Cache_Struct {
 
   CacheBlock blocks[NUM_CACHE_BLOCKS]; // there are 16 blocks in the cache
+  VictimBlock victims[MAX_VICTIM_ENTRIES]; //blocks evicted from the L1, only VICTIM_ENTRIES of them are used
+  TagStore victimTags; //their block addresses (the buffer is fully associative) and valid bits
   
 } Cache;
 
+/***************************************************************/
+/* VICTIM BUFFER CONFIGURATION                                 */
+/***************************************************************/
+int VICTIM_ENTRIES = 0; //0 = no victim buffer
+uint32_t VICTIM_HIT_PENALTY = 2; //cycles to swap a block back into the L1
+
 
 
 /***************************************************************/
 /* CACHE STATS                                                 */
 /***************************************************************/
-uint32_t cache_misses; //need to initialize to 0 at the beginning of simulation start
-uint32_t cache_hits;   //need to initialize to 0 at the beginning of simulation start
+CORE_LOCAL uint32_t cache_misses; //need to initialize to 0 at the beginning of simulation start
+CORE_LOCAL uint32_t cache_hits;   //need to initialize to 0 at the beginning of simulation start
+CORE_LOCAL uint32_t victim_hits;  //L1 misses caught by the victim buffer, counted in neither of the above
 
 
 /***************************************************************/
 /* CACHE OBJECT                                                */
 /***************************************************************/
-Cache L1Cache; //need to use this in the simulator
+CORE_LOCAL Cache L1Cache; //need to use this in the simulator
+
+/***************************************************************/
+/* Victim Buffer Function Declerations.                        */
+/***************************************************************/
+int victim_find(Cache *, uint32_t);
+int victim_lookup(uint32_t);
+void victim_insert(uint32_t);
+void configure_victim(int, int);
+
+/***************************************************************/
+/* BLOCK FILL ORDER                                            */
+/***************************************************************/
+/* Memory returns a missed block one word every FILL_BEAT_CYCLES, the last  */
+/* word CACHE_MISS_PENALTY cycles after the miss. FILL_WHOLE_BLOCK waits    */
+/* for all of it. FILL_EARLY_RESTART lets MEM go once the wanted word is    */
+/* in (words come in address order), FILL_CRITICAL_FIRST asks for the      */
+/* wanted word first and wraps around. Until the block is complete, an     */
+/* access to a word still on its way waits for that word and the next miss */
+/* waits for the memory channel.                                            */
+/***************************************************************/
+#define FILL_WHOLE_BLOCK 0
+#define FILL_EARLY_RESTART 1
+#define FILL_CRITICAL_FIRST 2
+
+typedef struct BlockFill_Struct {
+
+  int active;
+  uint32_t blockAddress;
+  uint32_t firstWord; //word memory sends first
+  uint32_t firstArrival; //cycle the first word is in the cache
+
+} BlockFill;
+
+int FILL_MODE = FILL_WHOLE_BLOCK;
+uint32_t FILL_BEAT_CYCLES = 8;
+
+CORE_LOCAL BlockFill blockFill; //latest block memory sent or is sending
+
+/* BLOCK FILL STATS */
+CORE_LOCAL uint32_t fill_early_restarts; //misses that went on before the whole block was in
+CORE_LOCAL uint32_t fill_cycles_saved; //miss cycles not spent waiting for the rest of the block
+CORE_LOCAL uint32_t fill_word_waits; //accesses that waited for a word of the block being filled
+CORE_LOCAL uint32_t fill_channel_waits; //cycles misses waited for the previous block to finish
+
+/***************************************************************/
+/* Block Fill Function Declerations.                           */
+/***************************************************************/
+uint32_t fill_start(uint32_t);
+uint32_t fill_word_arrival(uint32_t);
+int fill_word_pending(uint32_t);
+void configure_fill(int, int);
+
+/***************************************************************/
+/* STORE BUFFER                                                */
+/***************************************************************/
+/* Stores are written into the cache and queued here; the oldest entry is    */
+/* written to memory every STORE_DRAIN_CYCLES cycles in the background.      */
+/* Stores to a block that already has a (not yet draining) entry coalesce.   */
+/***************************************************************/
+typedef struct StoreBufferEntry_Struct {
+
+  uint32_t blockAddress;
+  uint32_t words[WORD_PER_BLOCK];
+  int mask; //bit i set = words[i] holds a store
+
+} StoreBufferEntry;
+
+typedef struct StoreBuffer_Struct {
+
+  StoreBufferEntry entries[MAX_STORE_BUFFER]; //circular FIFO
+  int head, count;
+  uint32_t drainDone; //cycle the head entry reaches memory, 0 = not draining yet
+
+} StoreBuffer;
+
+int STORE_BUFFER_SIZE = 4;
+uint32_t STORE_DRAIN_CYCLES = 4; //memory bandwidth, cycles to write one entry
+
+CORE_LOCAL StoreBuffer storeBuffer;
+
+/* STORE BUFFER STATS */
+CORE_LOCAL uint32_t store_buffer_stores;
+CORE_LOCAL uint32_t store_buffer_coalesced; //stores merged into an existing entry
+CORE_LOCAL uint32_t store_buffer_full_stalls; //cycles MEM waited for a free entry
+CORE_LOCAL uint32_t store_buffer_forwards; //fills that picked up data still in the buffer
+CORE_LOCAL uint64_t store_buffer_occupancy; //summed every cycle
 
 /***************************************************************/
-/* WRITE BUFFER                                         */
+/* Store Buffer Function Declerations.                         */
 /***************************************************************/
-CacheBlock writeBuffer;
+int store_buffer_find(StoreBuffer *, uint32_t);
+int store_buffer_blocked(uint32_t);
+void store_buffer_insert(uint32_t, uint32_t);
+void store_buffer_tick();
+void store_buffer_drain(StoreBuffer *, int);
+void store_buffer_flush(StoreBuffer *, uint32_t);
+void store_buffer_forward(uint32_t, uint32_t *);
+void configure_store_buffer(int, int);
+uint32_t mem_read_visible(uint32_t);
+void mem_write_visible(uint32_t, uint32_t);
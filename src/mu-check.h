@@ -0,0 +1,61 @@
+/******************************************************************************/
+/* LOCKSTEP REFERENCE CHECKER                                                 */
+/******************************************************************************/
+/* Every instruction that retires in WB() appends a commit record (what the  */
+/* pipeline wrote) to CHECK_LOG. When the log is full, the program exits or  */
+/* a run ends, a plain one-instruction-at-a-time MIPS interpreter replays the */
+/* log from its own registers and memory and compares each record, then the  */
+/* whole register file. The first mismatch stops the run with both values.   */
+/*                                                                            */
+/* The reference memory is copy-on-write: a page is copied before the        */
+/* pipeline first stores to it (or when the reference stores to it), until   */
+/* then the reference reads the real, untouched page.                        */
+/******************************************************************************/
+#define MAX_CHECK_BATCH 4096
+#define REF_PAGE_SHIFT 12
+#define REF_PAGE_SIZE (1 << REF_PAGE_SHIFT)
+#define REF_NUM_PAGES (1 << (32 - REF_PAGE_SHIFT))
+
+typedef struct Commit_Struct {
+
+  uint32_t cycle;
+  uint32_t PC;
+  uint32_t IR;
+  uint32_t dest; //register the instruction writes, 0 if none
+  uint32_t value; //pipeline's value of dest after WB
+  uint32_t HI, LO;
+  int store; //pipeline wrote memory
+  uint32_t address, data;
+
+} Commit;
+
+/***************************************************************/
+/* CHECKER CONFIGURATION AND STATE                             */
+/***************************************************************/
+int CHECKING = FALSE;
+int CHECK_BATCH = 1024; //commits per replay, 1 = stop right at the divergence
+Commit CHECK_LOG[MAX_CHECK_BATCH];
+int checkCount;
+int CHECK_FAILED;
+uint32_t CHECKED_COMMITS;
+
+CPU_State REF_STATE;
+uint8_t **REF_MEMORY; //REF_NUM_PAGES page pointers, NULL = same as real memory
+int refLinkValid; //LL/SC link of the reference
+uint32_t refLinkAddress;
+int refHalted; //reference executed the exit SYSCALL
+int refSlotPending; //reference is in a taken branch's delay slot
+uint32_t refSlotTarget;
+
+/***************************************************************/
+/* Checker Function Declerations.                              */
+/***************************************************************/
+void check_start();
+void check_commit(CPU_Pipeline_Reg *);
+void check_flush();
+void check_snapshot(uint32_t);
+int ref_step(Commit *);
+uint8_t *ref_page(uint32_t);
+uint32_t ref_read(uint32_t);
+void ref_write(uint32_t, uint32_t, int);
+void set_checking(int, int);
@@ -0,0 +1,91 @@
+/******************************************************************************/
+/* MULTI-CORE SUPPORT                                                         */
+/******************************************************************************/
+/* Every CORE_LOCAL global (registers, pipeline latches, L1Cache, stats) has  */
+/* one copy per host thread, so each thread simulates one core with the same */
+/* code as the single-core simulator. Core 0 is the main (shell) thread.      */
+/* Memory is shared; the L1 caches are kept coherent with a snooping MESI    */
+/* protocol, serialized by BUS_LOCK.                                          */
+/*                                                                            */
+/* Bus transactions (and everything else under BUS_LOCK) are granted in a   */
+/* fixed order: by cycle, then by core id. A core publishes the cycle it is  */
+/* in, and bus_lock() waits until every other running core is past that     */
+/* cycle or is in it with a higher id. The timing therefore does not depend */
+/* on how the host schedules the threads, nor on the quantum, which only    */
+/* sets how often the cores stop at a barrier for the main thread.           */
+/*                                                                            */
+/* Scalability: cores only overlap between bus transactions, and a core     */
+/* that wants the bus waits for the slowest one to reach its cycle, so the  */
+/* speedup over one thread is bounded by the share of cycles that stay off  */
+/* the bus and needs a host CPU per core. With quantum 1 the two barriers   */
+/* per cycle dominate; use a large quantum for speed.                        */
+/******************************************************************************/
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MAX_CORES 8
+
+/* bus transactions seen by the other caches */
+#define BUS_READ 0            //read miss
+#define BUS_READ_EXCLUSIVE 1  //write miss
+#define BUS_UPGRADE 2         //write hit on a Shared block
+
+/* bus order of a core: cycle, then core id (MAX_CORES fits in 8 bits) */
+#define BUS_POSITION(cycle, id) (((uint64_t)(cycle) << 8) | (uint64_t)(id))
+#define BUS_IDLE UINT64_MAX //not running, never holds up another core
+
+/* commands the main thread hands to the core threads at a quantum barrier */
+#define CORE_RUN 0
+#define CORE_RESET 1
+#define CORE_EXIT 2
+
+typedef struct Core_Struct {
+
+  int id;
+  pthread_t thread;
+  /* the core's CORE_LOCAL state, valid while its thread is alive */
+  CPU_State *state;
+  Cache *cache;
+  StoreBuffer *storeBuffer;
+  int *running;
+  uint32_t *instructions;
+  uint32_t *cycles;
+  uint32_t *hits;
+  uint32_t *misses;
+  /* BUS_POSITION of the cycle the core is in, BUS_IDLE outside a run */
+  atomic_ullong busPosition;
+  /* LL/SC link, only touched with BUS_LOCK held */
+  int llValid;
+  uint32_t llAddress;
+  /* coherence stats */
+  uint32_t busReads, busReadExclusives, busUpgrades;
+  uint32_t invalidations; //copies this core lost to another core's write
+  uint32_t interventions; //M/E copies this core downgraded to S for another core's read
+  uint32_t busWaits; //times this core yielded waiting for its turn on the bus
+
+} Core;
+
+int CORE_COUNT = 1;
+int CORE_QUANTUM = 100; //cycles a core may run ahead before syncing with the others, 1 = lockstep
+CORE_LOCAL int CORE_ID;
+Core CORES[MAX_CORES];
+
+pthread_mutex_t BUS_LOCK = PTHREAD_MUTEX_INITIALIZER;
+pthread_barrier_t CORE_START, CORE_DONE;
+int CORE_COMMAND;
+int CORE_COMMAND_CYCLES;
+
+/***************************************************************/
+/* Multi-core Function Declerations.                           */
+/***************************************************************/
+void register_core(int);
+void reset_core();
+void run_core(int);
+void *core_main(void *);
+void core_step(int, int);
+void start_cores(int, int);
+void stop_cores();
+int any_core_running();
+void bus_lock();
+void bus_unlock();
+int snoop(int, uint32_t);
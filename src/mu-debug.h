@@ -0,0 +1,57 @@
+/******************************************************************************/
+/* BREAKPOINTS AND WATCHPOINTS                                                */
+/******************************************************************************/
+/* A breakpoint stops run()/runAll() when the instruction at its PC retires. */
+/* A watchpoint stops them after a guest load/store touches its address      */
+/* range (and, optionally, only if the word read/written equals a value).    */
+/* Nothing is checked while none are set; with watchpoints set, only         */
+/* accesses to a page flagged in WATCH_PAGES look at the list.               */
+/******************************************************************************/
+#define MAX_BREAKPOINTS 16
+#define MAX_WATCHPOINTS 16
+#define WATCH_PAGE_SHIFT 12 //4KB pages
+#define WATCH_NUM_PAGES (1 << (32 - WATCH_PAGE_SHIFT))
+
+/* watchpoint types, also the page flag bits */
+#define WATCH_READ 1
+#define WATCH_WRITE 2
+
+typedef struct Watchpoint_Struct {
+
+  int valid;
+  int type; //WATCH_READ, WATCH_WRITE or both
+  uint32_t start, end; //inclusive byte range
+  int conditional; //only stop if the word equals value
+  uint32_t value;
+
+} Watchpoint;
+
+/***************************************************************/
+/* DEBUG STATE                                                 */
+/***************************************************************/
+uint32_t BREAKPOINTS[MAX_BREAKPOINTS];
+int BREAKPOINT_COUNT = 0;
+Watchpoint WATCHPOINTS[MAX_WATCHPOINTS];
+int WATCHPOINT_COUNT = 0;
+uint8_t *WATCH_PAGES = NULL; //WATCH_READ/WATCH_WRITE bits per page, allocated with the first watchpoint
+int DEBUG_STOP = FALSE; //set by any core, run()/runAll() stop at the end of that cycle
+
+/* guest access hooks, free when nothing is being watched */
+#define WATCH_ACCESS(pc, addr, val, type) do { \
+  if (WATCHPOINT_COUNT != 0 && (WATCH_PAGES[(addr) >> WATCH_PAGE_SHIFT] & (type))) watch_check(pc, addr, val, type); \
+} while (0)
+#define BREAK_CHECK(pc) do { \
+  if (BREAKPOINT_COUNT != 0) break_check(pc); \
+} while (0)
+
+/***************************************************************/
+/* Debug Function Declerations.                                */
+/***************************************************************/
+void break_check(uint32_t);
+void watch_check(uint32_t, uint32_t, uint32_t, int);
+void add_breakpoint(uint32_t);
+void add_watchpoint(int, uint32_t, uint32_t, int, uint32_t);
+void watch_pages_update();
+void delete_debug_points();
+void list_debug_points();
+int parse_watch_type(char *);
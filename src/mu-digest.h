@@ -0,0 +1,45 @@
+/******************************************************************************/
+/* STATE DIGESTS                                                              */
+/******************************************************************************/
+/* A 64-bit digest of the machine: every core's GPRs, HI and LO (not the    */
+/* PC, a fetch address that depends on the core model after the exit) and  */
+/* memory as the program sees it. mem_write_32() marks its 4KB page         */
+/* stale (one bit test on the fast path, first writes go on a list), and a   */
+/* digest rehashes only the stale pages and folds each page's change into a */
+/* running sum, so the cost follows what was written since the last one,    */
+/* not the size of memory. A page's share mixes its number with its hash;  */
+/* all-zero pages add nothing, so the digest depends on contents only, not  */
+/* on which zero pages happened to be written. Words still in a store       */
+/* buffer are hashed with their buffered value.                              */
+/******************************************************************************/
+#define DIGEST_PAGE_SHIFT 12
+#define DIGEST_PAGE_WORDS ((1 << DIGEST_PAGE_SHIFT) / 8) //64-bit lanes per page
+#define DIGEST_PAGES (1 << (32 - DIGEST_PAGE_SHIFT))
+
+/***************************************************************/
+/* DIGEST STATE                                                */
+/***************************************************************/
+uint64_t DIGEST_STALE[DIGEST_PAGES / 64]; //written since its hash was taken
+uint64_t DIGEST_TOUCHED[DIGEST_PAGES / 64]; //written since the memory was cleared
+uint32_t digestStaleList[DIGEST_PAGES];
+uint32_t digestTouchedList[DIGEST_PAGES];
+uint32_t digestStaleCount, digestTouchedCount;
+uint64_t digestShare[DIGEST_PAGES]; //each page's part of digestMemory
+uint64_t digestMemory; //sum of the shares of pages no longer stale
+
+#define DIGEST_BIT(page) (1ULL << ((page) & 63))
+#define DIGEST_TOUCH(addr) do { \
+  if (!(DIGEST_STALE[(addr) >> (DIGEST_PAGE_SHIFT + 6)] & DIGEST_BIT((addr) >> DIGEST_PAGE_SHIFT))) digest_touch((addr) >> DIGEST_PAGE_SHIFT); \
+} while (0)
+
+/***************************************************************/
+/* Digest Function Declerations.                               */
+/***************************************************************/
+void digest_touch(uint32_t);
+void digest_reset();
+uint64_t digest_mix(uint64_t);
+uint64_t digest_page(uint32_t, int);
+uint64_t digest_registers();
+uint64_t digest_memory();
+int digest_page_compare(const void *, const void *);
+void print_digest(int);
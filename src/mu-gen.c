@@ -0,0 +1,393 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/******************************************************************************/
+/* RANDOM PROGRAM GENERATOR                                                   */
+/******************************************************************************/
+/* Writes a program in the .in hex format the simulator loads: a prologue   */
+/* that seeds the registers, a body of -n random instructions run -i times, */
+/* and the exit SYSCALL. The body's mix is set in percent: RAW chains       */
+/* (sources taken from the last result), load-use pairs, forward branches   */
+/* and jumps, MULT/MULTU/DIV with MFHI/MFLO, and loads/stores walking a      */
+/* power-of-two footprint sequentially, with a stride, or at random (an     */
+/* xorshift in the program). The same seed gives the same program.         */
+/*                                                                            */
+/* Only instructions EX() implements are used, and not the ones it gets     */
+/* wrong (LUI on a non-zero register, LB/LH/SB/SH, SRA, DIVU, BGTZ), so      */
+/* "check 1 1" can replay any generated program. Divisors are forced into  */
+/* 1..255 and a branch never sits in another branch's delay slot.          */
+/******************************************************************************/
+#define DATA_BEGIN 0x10010000
+#define TEXT_BEGIN 0x00400000
+#define MAX_FOOTPRINT (1 << 28)
+
+/* register roles */
+#define REG_V0 2
+#define POOL_FIRST 8 //$t0..$t7 carry the data, RAW chains run through them
+#define POOL_SIZE 8
+#define REG_BASE 16 //start of the footprint
+#define REG_COUNT 17 //iterations left
+#define REG_ADDR 18 //address of the access / scratch
+#define REG_OFFSET 19 //offset into the footprint, xorshift state when random
+#define REG_MASK 20 //footprint - 1, word aligned
+
+#define PATTERN_SEQUENTIAL 0
+#define PATTERN_STRIDE 1
+#define PATTERN_RANDOM 2
+
+/* encodings */
+#define R_TYPE(rs, rt, rd, sa, funct) (((rs) << 21) | ((rt) << 16) | ((rd) << 11) | ((sa) << 6) | (funct))
+#define I_TYPE(op, rs, rt, imm) (((op) << 26) | ((rs) << 21) | ((rt) << 16) | ((imm) & 0xFFFF))
+#define J_TYPE(op, address) (((op) << 26) | (((address) >> 2) & 0x03FFFFFF))
+
+typedef struct Gen_Config_Struct {
+
+  uint32_t length; //body instructions
+  uint32_t iterations;
+  uint32_t seed;
+  int raw, loadUse, branches, memory, stores, muldiv; //percent
+  int pattern;
+  uint32_t stride, footprint; //bytes
+
+} Gen_Config;
+
+Gen_Config CONFIG = { 1000, 1, 1, 50, 50, 10, 25, 33, 5, PATTERN_SEQUENTIAL, 4, 4096 };
+uint32_t *PROGRAM;
+uint32_t programSize;
+uint64_t rngState;
+int lastResult = POOL_FIRST; //pool register written last
+int forceSource = -1; //load-use: the next ALU instruction reads this register
+
+/* counts for the summary */
+uint32_t genLoads, genStores, genBranches, genMuldiv, genLoadUse;
+
+/***************************************************************/
+/* generator helpers                                           */
+/***************************************************************/
+uint32_t rng()
+{
+	//xorshift64*, the C library's rand() differs between hosts
+	rngState ^= rngState >> 12;
+	rngState ^= rngState << 25;
+	rngState ^= rngState >> 27;
+	return (uint32_t)((rngState * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+int chance(int percent)
+{
+	return (int)(rng() % 100) < percent;
+}
+
+void emit(uint32_t word)
+{
+	PROGRAM[programSize++] = word;
+}
+
+uint32_t address_of(uint32_t index)
+{
+	return TEXT_BEGIN + 4 * index;
+}
+
+int pool_register()
+{
+	return POOL_FIRST + rng() % POOL_SIZE;
+}
+
+/* source operand: the last result with probability raw, otherwise any pool register */
+int source_register()
+{
+	int reg;
+
+	if (forceSource >= 0){
+		reg = forceSource;
+		forceSource = -1;
+		genLoadUse++;
+		return reg;
+	}
+	return chance(CONFIG.raw) ? lastResult : pool_register();
+}
+
+int destination_register()
+{
+	lastResult = pool_register();
+	return lastResult;
+}
+
+/* 32-bit constant into a register that is still zero (LUI keeps rt's low half) */
+void load_constant(int reg, uint32_t value)
+{
+	if (value >> 16){
+		emit(I_TYPE(0x0F, 0, reg, value >> 16)); //LUI
+		if (value & 0xFFFF){
+			emit(I_TYPE(0x0D, reg, reg, value)); //ORI
+		}
+	} else {
+		emit(I_TYPE(0x0D, 0, reg, value)); //ORI
+	}
+}
+
+/***************************************************************/
+/* one ALU instruction on the pool                             */
+/***************************************************************/
+void gen_alu()
+{
+	static const uint32_t functs[] = { 0x21, 0x23, 0x24, 0x25, 0x26, 0x27, 0x2A, 0x00, 0x02 }; //ADDU SUBU AND OR XOR NOR SLT SLL SRL
+	static const uint32_t immediates[] = { 0x09, 0x0A, 0x0C, 0x0D, 0x0E }; //ADDIU SLTI ANDI ORI XORI
+	uint32_t funct;
+	int rs, rt, rd;
+
+	if (chance(60)){
+		funct = functs[rng() % (sizeof(functs) / sizeof(functs[0]))];
+		if (funct == 0x00 || funct == 0x02){
+			rt = source_register();
+			rd = destination_register();
+			emit(R_TYPE(0, rt, rd, 1 + rng() % 31, funct));
+		} else {
+			rs = source_register();
+			rt = source_register();
+			rd = destination_register();
+			emit(R_TYPE(rs, rt, rd, 0, funct));
+		}
+	} else {
+		rs = source_register();
+		rt = destination_register();
+		emit(I_TYPE(immediates[rng() % (sizeof(immediates) / sizeof(immediates[0]))], rs, rt, rng()));
+	}
+}
+
+/***************************************************************/
+/* MULT/MULTU/DIV and reading HI/LO back                       */
+/***************************************************************/
+void gen_muldiv()
+{
+	int rs = source_register(), rt = source_register();
+
+	switch (rng() % 3){
+		case 0:
+			emit(R_TYPE(rs, rt, 0, 0, 0x18)); //MULT
+			break;
+		case 1:
+			emit(R_TYPE(rs, rt, 0, 0, 0x19)); //MULTU
+			break;
+		default:
+			//divisor in 1..255: no divide by zero, no INT_MIN / -1
+			emit(I_TYPE(0x0C, rt, REG_ADDR, 0xFF)); //ANDI
+			emit(I_TYPE(0x0D, REG_ADDR, REG_ADDR, 1)); //ORI
+			emit(R_TYPE(rs, REG_ADDR, 0, 0, 0x1A)); //DIV
+			break;
+	}
+	emit(R_TYPE(0, 0, destination_register(), 0, 0x12)); //MFLO
+	if (chance(50)){
+		emit(R_TYPE(0, 0, destination_register(), 0, 0x10)); //MFHI
+	}
+	genMuldiv++;
+}
+
+/***************************************************************/
+/* a load or a store at the next address of the pattern                  */
+/***************************************************************/
+void gen_memory()
+{
+	int reg;
+
+	if (CONFIG.pattern == PATTERN_RANDOM){
+		emit(R_TYPE(0, REG_OFFSET, REG_ADDR, 13, 0x00)); //SLL
+		emit(R_TYPE(REG_OFFSET, REG_ADDR, REG_OFFSET, 0, 0x26)); //XOR
+		emit(R_TYPE(0, REG_OFFSET, REG_ADDR, 17, 0x02)); //SRL
+		emit(R_TYPE(REG_OFFSET, REG_ADDR, REG_OFFSET, 0, 0x26));
+		emit(R_TYPE(0, REG_OFFSET, REG_ADDR, 5, 0x00));
+		emit(R_TYPE(REG_OFFSET, REG_ADDR, REG_OFFSET, 0, 0x26));
+		emit(R_TYPE(REG_OFFSET, REG_MASK, REG_ADDR, 0, 0x24)); //AND
+		emit(R_TYPE(REG_BASE, REG_ADDR, REG_ADDR, 0, 0x21)); //ADDU
+	} else {
+		emit(I_TYPE(0x09, REG_OFFSET, REG_OFFSET, CONFIG.pattern == PATTERN_STRIDE ? CONFIG.stride : 4)); //ADDIU
+		emit(R_TYPE(REG_OFFSET, REG_MASK, REG_OFFSET, 0, 0x24)); //AND
+		emit(R_TYPE(REG_BASE, REG_OFFSET, REG_ADDR, 0, 0x21)); //ADDU
+	}
+	if (chance(CONFIG.stores)){
+		emit(I_TYPE(0x2B, REG_ADDR, source_register(), 0)); //SW
+		genStores++;
+	} else {
+		reg = destination_register();
+		emit(I_TYPE(0x23, REG_ADDR, reg, 0)); //LW
+		if (chance(CONFIG.loadUse)){
+			forceSource = reg;
+		}
+		genLoads++;
+	}
+}
+
+/***************************************************************/
+/* forward branch or jump over 1-4 instructions, all inside the body          */
+/***************************************************************/
+void gen_branch(uint32_t bodyEnd)
+{
+	uint32_t skip, target;
+	int rs, rt;
+
+	skip = 1 + rng() % 4;
+	if (programSize + 1 + skip > bodyEnd){
+		gen_alu(); //no room left in the body
+		return;
+	}
+	target = programSize + 1 + skip;
+	rs = source_register();
+	switch (rng() % 6){
+		case 0:
+			rt = source_register();
+			emit(I_TYPE(0x04, rs, rt, target - programSize - 1)); //BEQ
+			break;
+		case 1:
+			rt = source_register();
+			emit(I_TYPE(0x05, rs, rt, target - programSize - 1)); //BNE
+			break;
+		case 2:
+			emit(I_TYPE(0x06, rs, 0, target - programSize - 1)); //BLEZ
+			break;
+		case 3:
+			emit(I_TYPE(0x01, rs, 1, target - programSize - 1)); //BGEZ
+			break;
+		case 4:
+			emit(I_TYPE(0x01, rs, 0, target - programSize - 1)); //BLTZ
+			break;
+		default:
+			emit(J_TYPE(0x02, address_of(target))); //J
+			break;
+	}
+	genBranches++;
+	gen_alu(); //never another branch in the delay slot
+}
+
+/***************************************************************/
+/* the whole program                                           */
+/***************************************************************/
+void generate()
+{
+	uint32_t top, bodyEnd;
+	int i, kind;
+
+	//prologue: pool, footprint, iteration count
+	for (i = 0; i < POOL_SIZE; i++){
+		emit(I_TYPE(0x09, 0, POOL_FIRST + i, 1 + rng() % 0x7FFF)); //ADDIU
+	}
+	load_constant(REG_BASE, DATA_BEGIN);
+	load_constant(REG_MASK, (CONFIG.footprint - 1) & ~3);
+	if (CONFIG.pattern == PATTERN_RANDOM){
+		load_constant(REG_OFFSET, rng() | 1); //xorshift state, never zero
+	}
+	load_constant(REG_COUNT, CONFIG.iterations);
+
+	//body: -n instructions, helpers can overshoot by a few
+	top = programSize;
+	bodyEnd = top + CONFIG.length;
+	while (programSize < bodyEnd){
+		kind = rng() % 100;
+		if (forceSource >= 0 || kind >= CONFIG.memory + CONFIG.branches + CONFIG.muldiv){
+			gen_alu();
+		} else if (kind < CONFIG.memory){
+			gen_memory();
+		} else if (kind < CONFIG.memory + CONFIG.branches){
+			gen_branch(bodyEnd);
+		} else {
+			gen_muldiv();
+		}
+	}
+
+	//loop back (J, a body can be longer than a branch reaches), then exit
+	emit(I_TYPE(0x09, REG_COUNT, REG_COUNT, -1)); //ADDIU
+	emit(I_TYPE(0x04, REG_COUNT, 0, 3)); //BEQ to the exit
+	emit(0); //NOP, the delay slot when it is on
+	emit(J_TYPE(0x02, address_of(top)));
+	emit(0);
+	emit(I_TYPE(0x09, 0, REG_V0, 10)); //ADDIU $v0, $zero, 10
+	emit(0x0000000C); //SYSCALL
+}
+
+void usage(const char *name)
+{
+	printf("Usage: %s [options]\n", name);
+	printf("  -n <count>\tbody instructions (%u)\n", CONFIG.length);
+	printf("  -i <count>\ttimes the body runs (%u)\n", CONFIG.iterations);
+	printf("  -s <seed>\trandom seed (%u)\n", CONFIG.seed);
+	printf("  -r <%%>\tsource operands that read the last result (RAW chains) (%d)\n", CONFIG.raw);
+	printf("  -u <%%>\tloads followed right away by a use of the loaded value (%d)\n", CONFIG.loadUse);
+	printf("  -b <%%>\tbody slots that are a forward branch or jump (%d)\n", CONFIG.branches);
+	printf("  -m <%%>\tbody slots that are a load or store (%d)\n", CONFIG.memory);
+	printf("  -w <%%>\tmemory accesses that are stores (%d)\n", CONFIG.stores);
+	printf("  -d <%%>\tbody slots that are MULT/MULTU/DIV + MFLO/MFHI (%d)\n", CONFIG.muldiv);
+	printf("  -p <seq/stride/random>\taccess pattern (seq)\n");
+	printf("  -t <bytes>\tstride, a multiple of 4 below 32768 (%u)\n", CONFIG.stride);
+	printf("  -f <bytes>\tfootprint, a power of two from 4 to %d (%u)\n", MAX_FOOTPRINT, CONFIG.footprint);
+	printf("  -o <file>\twrite the program here instead of stdout\n");
+}
+
+int main(int argc, char *argv[]) {
+	FILE *out = stdout;
+	const char *path = NULL;
+	uint32_t i;
+	int option;
+
+	while ((option = getopt(argc, argv, "n:i:s:r:u:b:m:w:d:p:t:f:o:h")) != -1){
+		switch (option){
+			case 'n': CONFIG.length = strtoul(optarg, NULL, 0); break;
+			case 'i': CONFIG.iterations = strtoul(optarg, NULL, 0); break;
+			case 's': CONFIG.seed = strtoul(optarg, NULL, 0); break;
+			case 'r': CONFIG.raw = atoi(optarg); break;
+			case 'u': CONFIG.loadUse = atoi(optarg); break;
+			case 'b': CONFIG.branches = atoi(optarg); break;
+			case 'm': CONFIG.memory = atoi(optarg); break;
+			case 'w': CONFIG.stores = atoi(optarg); break;
+			case 'd': CONFIG.muldiv = atoi(optarg); break;
+			case 't': CONFIG.stride = strtoul(optarg, NULL, 0); break;
+			case 'f': CONFIG.footprint = strtoul(optarg, NULL, 0); break;
+			case 'o': path = optarg; break;
+			case 'p':
+				if (strcmp(optarg, "seq") == 0){
+					CONFIG.pattern = PATTERN_SEQUENTIAL;
+				} else if (strcmp(optarg, "stride") == 0){
+					CONFIG.pattern = PATTERN_STRIDE;
+				} else if (strcmp(optarg, "random") == 0){
+					CONFIG.pattern = PATTERN_RANDOM;
+				} else {
+					usage(argv[0]);
+					exit(1);
+				}
+				break;
+			default:
+				usage(argv[0]);
+				exit(option == 'h' ? 0 : 1);
+		}
+	}
+	if (CONFIG.length < 1 || CONFIG.iterations < 1 || CONFIG.footprint < 4 || CONFIG.footprint > MAX_FOOTPRINT
+		|| (CONFIG.footprint & (CONFIG.footprint - 1)) != 0 || CONFIG.stride % 4 != 0 || CONFIG.stride >= 32768
+		|| CONFIG.raw < 0 || CONFIG.raw > 100 || CONFIG.loadUse < 0 || CONFIG.loadUse > 100
+		|| CONFIG.stores < 0 || CONFIG.stores > 100 || CONFIG.branches < 0 || CONFIG.memory < 0 || CONFIG.muldiv < 0
+		|| CONFIG.branches + CONFIG.memory + CONFIG.muldiv > 100){
+		printf("Invalid configuration (the branch, memory and mul/div shares add up to at most 100)\n");
+		usage(argv[0]);
+		exit(1);
+	}
+
+	rngState = 0x9E3779B97F4A7C15ULL ^ CONFIG.seed;
+	rng();
+	PROGRAM = malloc((CONFIG.length + 64) * sizeof(uint32_t)); //prologue, a helper's overshoot, loop and exit
+	generate();
+
+	if (path != NULL && (out = fopen(path, "w")) == NULL){
+		printf("Error: Can't open %s for writing\n", path);
+		exit(1);
+	}
+	for (i = 0; i < programSize; i++){
+		fprintf(out, "%08X\n", PROGRAM[i]);
+	}
+	if (out != stdout){
+		fclose(out);
+	}
+	fprintf(stderr, "%u words: %u loads (%u used right away), %u stores, %u branches, %u mul/div\n",
+		programSize, genLoads, genLoadUse, genStores, genBranches, genMuldiv);
+	free(PROGRAM);
+	return 0;
+}
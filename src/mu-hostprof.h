@@ -0,0 +1,70 @@
+/******************************************************************************/
+/* HOST SELF-PROFILING                                                        */
+/******************************************************************************/
+/* Built with -DHOST_PROFILE (make HOSTPROF=-DHOST_PROFILE), the simulator   */
+/* times itself: host ticks (rdtsc on x86, clock_gettime elsewhere) spent in */
+/* each pipeline stage, the whole cycle, the L1 lookup and the memory array  */
+/* reads and writes. Times are inclusive (MEM contains the cache lookup,    */
+/* which contains memory reads) and per host thread, so each core keeps its */
+/* own. The report gives ns per simulated cycle and the MIPS the simulator  */
+/* would reach if that section were all it ran. Without -DHOST_PROFILE the  */
+/* macros expand to nothing.                                                 */
+/******************************************************************************/
+#ifdef HOST_PROFILE
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HOST_TSC 1
+#endif
+
+#define HOST_CYCLE 0 //cycle(), everything
+#define HOST_WB 1
+#define HOST_MEM 2
+#define HOST_EX 3
+#define HOST_ID 4
+#define HOST_IF 5
+#define HOST_CACHE 6 //cache_access()
+#define HOST_MEM_READ 7 //mem_read_32()
+#define HOST_MEM_WRITE 8 //mem_write_32()
+#define HOST_SECTIONS 9
+
+#define HOST_CALIBRATE_NS 20000000 //how long tick rate calibration takes
+
+/***************************************************************/
+/* HOST PROFILER STATE                                         */
+/***************************************************************/
+CORE_LOCAL uint64_t HOST_TICKS[HOST_SECTIONS];
+CORE_LOCAL uint64_t HOST_CALLS[HOST_SECTIONS];
+double hostNsPerTick; //0 until calibrated
+const char *HOST_SECTION_NAMES[HOST_SECTIONS] = { "cycle", "WB", "MEM", "EX", "ID", "IF", "cache lookup", "mem_read_32", "mem_write_32" };
+
+static inline uint64_t host_now()
+{
+#ifdef HOST_TSC
+  return __rdtsc();
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+#endif
+}
+
+#define HOST_PROF_BEGIN(section) uint64_t hostStart_##section = host_now()
+#define HOST_PROF_END(section) do { \
+  HOST_TICKS[section] += host_now() - hostStart_##section; \
+  HOST_CALLS[section]++; \
+} while (0)
+
+/***************************************************************/
+/* Host Profiler Function Declerations.                        */
+/***************************************************************/
+void host_profile_reset();
+double host_ns_per_tick();
+void print_host_profile();
+
+#else
+
+#define HOST_PROF_BEGIN(section)
+#define HOST_PROF_END(section)
+
+#endif
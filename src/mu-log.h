@@ -0,0 +1,85 @@
+/******************************************************************************/
+/* LOGGING                                                                    */
+/******************************************************************************/
+/* LOG(category, level, format, args...) replaces the printf's the hot paths */
+/* used to make on every access. A record is the format string, the cycle,   */
+/* the core and up to LOG_ARGS uint32_t arguments: producers (any core       */
+/* thread) claim a slot of a bounded lock-free ring and never format or      */
+/* touch a FILE. A background thread drains the ring in order, formats the   */
+/* records and writes them to LOG_FILE.                                      */
+/*                                                                            */
+/* A level above LOG_MAX_LEVEL is a constant-false test, so building with   */
+/* -DLOG_MAX_LEVEL=0 compiles every call site out. Below that, each         */
+/* category's runtime level is one load and compare, all off by default.    */
+/******************************************************************************/
+#include <stdatomic.h>
+
+#define LOG_OFF 0
+#define LOG_INFO 1
+#define LOG_DEBUG 2
+#define LOG_TRACE 3
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL LOG_TRACE
+#endif
+
+#define LOG_CACHE 0
+#define LOG_PIPELINE 1
+#define LOG_LOADER 2
+#define LOG_CATEGORIES 3
+
+#define LOG_ARGS 4
+#define LOG_RING_SIZE (1 << 16) //records, a power of two
+#define LOG_DRAIN_SLEEP_NS 1000000 //drain thread naps this long when the ring is empty
+#define LOG_DEFAULT_FILE "mu-mips.log"
+
+typedef struct Log_Record_Struct {
+
+  atomic_uint sequence; //== position when free, position + 1 once written
+  const char *format;
+  uint32_t cycle;
+  uint8_t core, category;
+  uint32_t args[LOG_ARGS];
+
+} Log_Record;
+
+/***************************************************************/
+/* LOGGING CONFIGURATION                                       */
+/***************************************************************/
+int LOG_LEVELS[LOG_CATEGORIES]; //runtime level per category, LOG_OFF..LOG_TRACE
+char LOG_FILE[256] = LOG_DEFAULT_FILE;
+const char *LOG_CATEGORY_NAMES[LOG_CATEGORIES] = { "cache", "pipeline", "loader" };
+
+/***************************************************************/
+/* LOGGING STATE                                               */
+/***************************************************************/
+Log_Record *_Atomic logRing; //NULL while the sink is stopped
+atomic_int logWriters; //producers inside log_write(), log_stop() waits for 0 before freeing
+atomic_uint logHead; //next position a producer claims
+uint32_t logTail; //next position the drain thread reads, drain thread only
+atomic_int logStop;
+pthread_t logThread;
+FILE *logOut;
+
+/***************************************************************/
+/* LOGGING STATS                                               */
+/***************************************************************/
+atomic_uint LOG_RECORDS;
+atomic_uint LOG_FULL_WAITS; //times a producer found the ring full and yielded
+
+#define LOG_ENABLED(category, level) ((level) <= LOG_MAX_LEVEL && (level) <= LOG_LEVELS[category])
+#define LOG(category, level, format, ...) do { \
+  if (LOG_ENABLED(category, level)) log_write(category, format, (const uint32_t[LOG_ARGS]){ __VA_ARGS__ }); \
+} while (0)
+
+/***************************************************************/
+/* Logging Function Declerations.                              */
+/***************************************************************/
+void log_write(int, const char *, const uint32_t *);
+int log_drain(Log_Record *);
+void *log_main(void *);
+int log_start();
+void log_stop();
+void configure_logging(const char *, int);
+void set_log_file(const char *);
+void print_log_stats();
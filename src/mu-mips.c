@@ -3,9 +3,31 @@
 #include <string.h>
 #include <stdint.h>
 #include <assert.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
+#include "mumips.h"
 #include "mu-mips.h"
 #include "mu-cache.h"
+#include "mu-ooo.h"
+#include "mu-core.h"
+#include "mu-prefetch.h"
+#include "mu-debug.h"
+#include "mu-check.h"
+#include "mu-sample.h"
+#include "mu-syscall.h"
+#include "mu-profile.h"
+#include "mu-reuse.h"
+#include "mu-3c.h"
+#include "mu-spm.h"
+#include "mu-tlb.h"
+#include "mu-log.h"
+#include "mu-hostprof.h"
+#include "mu-digest.h"
 
 /***************************************************************/
 /* Print out a list of commands available                                                                  */
@@ -24,6 +46,37 @@ void help() {
 	printf("print\t-- print the program loaded into memory\n");
 	printf("show\t-- print the current content of the pipeline registers\n");
 	printf("forwarding\t-- Enable or disable data forwarding in the pipeline\n");
+	printf("superscalar <0/1>\t-- Enable or disable dual-issue (2-wide in-order) mode\n");
+	printf("ooo <0/1>\t-- Use the out-of-order core model instead of the 5-stage pipeline\n");
+	printf("oooconfig <rob> <width> <alu lat> <muldiv lat> <mem lat>\t-- size the out-of-order core\n");
+	printf("cores <n> <quantum>\t-- simulate n cores, synchronized every <quantum> cycles (1 = lockstep; timing is the same for any quantum)\n");
+	printf("break <address>\t-- stop run/sim when the instruction at <address> retires\n");
+	printf("watch <r/w/rw> <start> <end>\t-- stop run/sim after a load/store touches the address range\n");
+	printf("watchif <r/w/rw> <start> <end> <value>\t-- same, only if the word read/written equals <value>\n");
+	printf("breaks\t-- list breakpoints and watchpoints\n");
+	printf("delete\t-- delete all breakpoints and watchpoints\n");
+	printf("check <0/1> <batch>\t-- replay retired instructions on a reference interpreter and stop at the first mismatch\n");
+	printf("sample <period> <warmup> <window> <0/1>\t-- time only <window> of every <period> instructions after <warmup>, 1 = keep the cache warm in between (0 0 0 0 = off)\n");
+	printf("branch <0/1> <0/1>\t-- resolve branches/jumps in EX (0) or ID (1); 1 = MIPS branch delay slot\n");
+	printf("skip <0/1>\t-- jump over cycles spent only waiting on a cache miss (same results, faster)\n");
+	printf("storebuffer <entries> <drain cycles>\t-- coalescing store buffer between the L1 and memory\n");
+	printf("fill <0/1/2> <cycles per word>\t-- miss refill: 0 whole block, 1 early restart, 2 critical word first\n");
+	printf("scratchpad <0/1> <begin> <bytes>\t-- single-cycle scratchpad window that bypasses the cache, DMA registers at 0x1FFF0000\n");
+	printf("dma <setup cycles> <cycles per word>\t-- speed of the scratchpad's DMA engine\n");
+	printf("mmu <0/1/2> <refill cycles>\t-- TLBs in IF and MEM: 0 off, 1 hardware page walk, 2 software refill (trap); page table reads go through the L1\n");
+	printf("tlb <i/d> <entries> <ways>\t-- size the I-TLB or the D-TLB\n");
+	printf("log <cache/pipeline/loader/all> <0-3>\t-- log level (off, info, debug, trace), records go to the log file from a background thread\n");
+	printf("digest [pages]\t-- 64-bit digest of the registers and memory (pages: per-page hashes of written memory)\n");
+	printf("logfile <path>\t-- where the log goes (default %s)\n", LOG_DEFAULT_FILE);
+	printf("waybench\t-- lookups per second of the scalar and SIMD way-lookup kernels, by associativity\n");
+	printf("victim <entries> <latency>\t-- fully-associative victim buffer behind the L1 (0 entries = off, or 2..16)\n");
+	printf("profile <0/1> <n>\t-- count retires, stall cycles and D-cache misses per instruction, report the top <n> at exit\n");
+	printf("profile\t-- print the hot-spot report now\n");
+	printf("reuse <0/1> <window>\t-- reuse-distance histogram of data blocks and working set per <window> instructions, reported at exit\n");
+	printf("reuse\t-- print the reuse-distance report now\n");
+	printf("misses <0/1>\t-- split cache misses into compulsory/capacity/conflict per PC and data region (shown in stats)\n");
+	printf("prefetch <mode> <degree> <distance>\t-- data prefetcher: 0 off, 1 next-N-line, 2 PC stride\n");
+	printf("stats\t-- print cycle, instruction, cache and issue statistics\n");
 	printf("?\t-- display help menu\n");
 	printf("quit\t-- exit the simulator\n\n");
 	printf("------------------------------------------------------------------\n\n");
@@ -35,16 +88,20 @@ void help() {
 uint32_t mem_read_32(uint32_t address)
 {
 	int i;
+	uint32_t value = 0;
+	HOST_PROF_BEGIN(HOST_MEM_READ);
 	for (i = 0; i < NUM_MEM_REGION; i++) {
 		if ( (address >= MEM_REGIONS[i].begin) &&  ( address <= MEM_REGIONS[i].end) ) {
 			uint32_t offset = address - MEM_REGIONS[i].begin;
-			return (MEM_REGIONS[i].mem[offset+3] << 24) |
+			value = (MEM_REGIONS[i].mem[offset+3] << 24) |
 					(MEM_REGIONS[i].mem[offset+2] << 16) |
 					(MEM_REGIONS[i].mem[offset+1] <<  8) |
 					(MEM_REGIONS[i].mem[offset+0] <<  0);
+			break;
 		}
 	}
-	return 0;
+	HOST_PROF_END(HOST_MEM_READ);
+	return value;
 }
 
 /***************************************************************/
@@ -54,6 +111,8 @@ void mem_write_32(uint32_t address, uint32_t value)
 {
 	int i;
 	uint32_t offset;
+	HOST_PROF_BEGIN(HOST_MEM_WRITE);
+	DIGEST_TOUCH(address);
 	for (i = 0; i < NUM_MEM_REGION; i++) {
 		if ( (address >= MEM_REGIONS[i].begin) && (address <= MEM_REGIONS[i].end) ) {
 			offset = address - MEM_REGIONS[i].begin;
@@ -64,15 +123,64 @@ void mem_write_32(uint32_t address, uint32_t value)
 			MEM_REGIONS[i].mem[offset+0] = (value >>  0) & 0xFF;
 		}
 	}
+	HOST_PROF_END(HOST_MEM_WRITE);
 }
 
 /***************************************************************/
 /* Execute one cycle                                                                                                              */
 /***************************************************************/
 void cycle() {                                                
-	handle_pipeline();
+	HOST_PROF_BEGIN(HOST_CYCLE);
+	if (OOO_MODE){
+		handle_ooo();
+	}else{
+		handle_pipeline();
+	}
 	CURRENT_STATE = NEXT_STATE;
 	CYCLE_COUNT++;
+	HOST_PROF_END(HOST_CYCLE);
+}
+
+/***************************************************************/
+/* While the pipeline waits on a miss every stage but MEM returns straight away,  */
+/* so jump over the cycles where MEM would only count the stall. Stops before     */
+/* the fill and before any store buffer drain or prefetch arrival, which are the  */
+/* only other things a stalled cycle can do. Returns the cycles skipped.              */
+/***************************************************************/
+int cycle_skip(int limit) {
+	int i, skip;
+	
+	if (!CYCLE_SKIPPING || OOO_MODE || cacheStalling == 0 || !RUN_FLAG){
+		return 0;
+	}
+	skip = (int)missLatency - cacheStalling; //cycles left that only do cacheStalling++
+	if (skip > limit){
+		skip = limit;
+	}
+	if (storeBuffer.count != 0){
+		if (storeBuffer.drainDone == 0){
+			return 0;
+		}
+		if ((int)(storeBuffer.drainDone - CYCLE_COUNT) < skip){
+			skip = storeBuffer.drainDone - CYCLE_COUNT;
+		}
+	}
+	if (PREFETCH_MODE != PREFETCH_OFF){
+		for (i = 0; i < PREFETCH_QUEUE_SIZE; i++){
+			if (prefetchQueue[i].valid && (int)(prefetchQueue[i].readyCycle - CYCLE_COUNT) < skip){
+				skip = prefetchQueue[i].readyCycle - CYCLE_COUNT;
+			}
+		}
+	}
+	if (skip <= 0){
+		return 0;
+	}
+	cacheStalling += skip;
+	PROFILE_STALL(memory_slot()->PC, skip);
+	store_buffer_occupancy += (uint64_t)storeBuffer.count * skip;
+	CYCLE_COUNT += skip;
+	SKIPPED_CYCLES += skip;
+	return skip;
 }
 
 /***************************************************************/
@@ -80,19 +188,24 @@ void cycle() {
 /***************************************************************/
 void run(int num_cycles) {                                      
 	
-	if (RUN_FLAG == FALSE) {
+	if (!any_core_running()) {
 		printf("Simulation Stopped\n\n");
 		return;
 	}
 
 	printf("Running simulator for %d cycles...\n\n", num_cycles);
-	int i;
-	for (i = 0; i < num_cycles; i++) {
-		if (RUN_FLAG == FALSE) {
-			printf("Simulation Stopped.\n\n");
-			break;
+	LOG(LOG_PIPELINE, LOG_INFO, "run for %u cycles from 0x%08x", num_cycles, CURRENT_STATE.PC);
+	if (simulate(num_cycles, NULL, NULL) < (uint32_t)num_cycles && !any_core_running()) {
+		printf("Simulation Stopped.\n\n");
+		if (PROFILE_DATA != NULL) {
+			print_profile();
 		}
-		cycle();
+		if (REUSE_ON) {
+			print_reuse();
+		}
+#ifdef HOST_PROFILE
+		print_host_profile();
+#endif
 	}
 }
 
@@ -100,16 +213,321 @@ void run(int num_cycles) {
 /* simulate to completion                                                                                               */
 /***************************************************************/
 void runAll() {                                                     
-	if (RUN_FLAG == FALSE) {
+	if (!any_core_running()) {
 		printf("Simulation Stopped.\n\n");
 		return;
 	}
 
 	printf("Simulation Started...\n\n");
-	while (RUN_FLAG){
-		cycle();
+	LOG(LOG_PIPELINE, LOG_INFO, "run to completion from 0x%08x", CURRENT_STATE.PC);
+	simulate(0xFFFFFFFF, NULL, NULL);
+	if (!DEBUG_STOP) {
+		printf("\nSimulation Finished.\n\n");
+		if (PROFILE_DATA != NULL) {
+			print_profile();
+		}
+		if (REUSE_ON) {
+			print_reuse();
+		}
+#ifdef HOST_PROFILE
+		print_host_profile();
+#endif
+	}
+}
+
+/***************************************************************/
+/* Simulate up to num_cycles cycles. Stops early when the program exits, at a   */
+/* breakpoint/watchpoint, or when until(arg) returns non-zero (checked between  */
+/* cycles, or between quanta with several cores). Returns the cycles simulated. */
+/***************************************************************/
+uint32_t simulate(uint32_t num_cycles, int (*until)(void *), void *arg) {
+	uint32_t done = 0, n;
+	int running = any_core_running();
+	
+	DEBUG_STOP = FALSE;
+	if (CHECKING && CYCLE_COUNT == 0) {
+		check_start();
+	}
+	while (done < num_cycles && any_core_running() && !DEBUG_STOP) {
+		if (until != NULL && until(arg)) {
+			break;
+		}
+		if (CORE_COUNT > 1) {
+			/*all cores advance one quantum at a time*/
+			n = (num_cycles - done < CORE_QUANTUM) ? num_cycles - done : CORE_QUANTUM;
+			core_step(CORE_RUN, n);
+			done += n;
+		}else if (SAMPLE_PERIOD != 0 && !OOO_MODE && !CHECKING) {
+			done += sample_step(num_cycles - done);
+		}else {
+			cycle();
+			done++;
+			if (!DEBUG_STOP) {
+				n = num_cycles - done;
+				done += cycle_skip(n > 0x7FFFFFFF ? 0x7FFFFFFF : n);
+			}
+		}
+	}
+	if (CHECKING) {
+		check_flush();
+	}
+	guest_output_flush();
+	if (running && !any_core_running()) {
+		LOG(LOG_PIPELINE, LOG_INFO, "program exited after %u cycles, %u instructions", CYCLE_COUNT, INSTRUCTION_COUNT);
+	}else if (DEBUG_STOP) {
+		LOG(LOG_PIPELINE, LOG_INFO, "stopped at a breakpoint or watchpoint, PC 0x%08x", CURRENT_STATE.PC);
+	}
+	return done;
+}
+
+/***************************************************************/
+/* Sampled simulation: advance the current phase by one step (a detailed cycle,  */
+/* or one instruction when fast-forwarding). Returns the steps taken, which is 0 */
+/* when only the phase changed.                                                               */
+/***************************************************************/
+uint32_t sample_step(uint32_t limit) {
+	uint32_t done = INSTRUCTION_COUNT - samplePhaseStart, n = 0;
+	
+	switch (samplePhase) {
+		case SAMPLE_FAST:
+			if (done >= SAMPLE_PERIOD - SAMPLE_WARMUP - SAMPLE_WINDOW) {
+				samplePhase = SAMPLE_WARM;
+				samplePhaseStart = INSTRUCTION_COUNT;
+				return 0;
+			}
+			fast_step();
+			return 1;
+		case SAMPLE_WARM:
+			if (done >= SAMPLE_WARMUP) {
+				samplePhase = SAMPLE_MEASURE;
+				samplePhaseStart = INSTRUCTION_COUNT;
+				windowCycles = CYCLE_COUNT;
+				windowHits = cache_hits + victim_hits;
+				windowMisses = cache_misses;
+				return 0;
+			}
+			break;
+		case SAMPLE_MEASURE:
+			if (done >= SAMPLE_WINDOW) {
+				sample_window_done();
+				samplePhase = SAMPLE_DRAIN;
+				samplePhaseStart = INSTRUCTION_COUNT; //instructions drained count towards the next unit
+				sampleDraining = TRUE;
+				return 0;
+			}
+			break;
+		case SAMPLE_DRAIN:
+			if (pipeline_empty()) {
+				//untimed execution reads and writes memory directly
+				bus_lock();
+				store_buffer_drain(&storeBuffer, storeBuffer.count);
+				bus_unlock();
+				sampleDraining = FALSE;
+				samplePhase = SAMPLE_FAST;
+				return 0;
+			}
+			break;
+	}
+	cycle();
+	n = 1;
+	if (!DEBUG_STOP && limit > 1) {
+		n += cycle_skip(limit - 1 > 0x7FFFFFFF ? 0x7FFFFFFF : limit - 1);
+	}
+	return n;
+}
+
+/***************************************************************/
+/* Sampled simulation: end of a measured window, add it to the estimates              */
+/***************************************************************/
+void sample_window_done() {
+	uint32_t instructions = INSTRUCTION_COUNT - samplePhaseStart;
+	uint32_t hits = cache_hits + victim_hits - windowHits, misses = cache_misses - windowMisses;
+	double cpi, rate;
+	
+	cpi = (double)(CYCLE_COUNT - windowCycles) / instructions;
+	sampleCPISum += cpi;
+	sampleCPISquares += cpi * cpi;
+	SAMPLE_UNITS++;
+	if (hits + misses != 0) {
+		rate = (double)misses / (hits + misses);
+		sampleMissSum += rate;
+		sampleMissSquares += rate * rate;
+		sampleMissUnits++;
+	}
+}
+
+/***************************************************************/
+/* TRUE when no instruction is in flight                                                           */
+/***************************************************************/
+int pipeline_empty() {
+	return cacheStalling == 0 && !IF_ID.valid && !ID_EX.valid && !EX_MEM.valid && !MEM_WB.valid &&
+		!IF_ID_2.valid && !ID_EX_2.valid && !EX_MEM_2.valid && !MEM_WB_2.valid;
+}
+
+/***************************************************************/
+/* Sampled simulation: execute one instruction without timing it                                */
+/***************************************************************/
+void fast_step() {
+	CPU_Pipeline_Reg reg;
+	
+	memset(&reg, 0, sizeof(reg));
+	if (SAMPLE_WARM_CACHE && MMU_MODE != MMU_OFF) {
+		tlb_lookup(ITLB, NEXT_STATE.PC, FALSE);
+	}
+	reg.IR = mem_read_32(NEXT_STATE.PC);
+	reg.PC = NEXT_STATE.PC;
+	reg.valid = 1;
+	NEXT_STATE.PC += 4;
+	take_delayed_branch();
+	decode_fields(&reg);
+	reg.A = NEXT_STATE.REGS[reg.registerRs];
+	reg.B = NEXT_STATE.REGS[reg.registerRt];
+	execute(&reg);
+	if ((SPM_CONTAINS(reg.ALUOutput) || DMA_REGISTER(reg.ALUOutput)) && (reg.memory_reference_load || reg.memory_reference_store)) {
+		spm_access(&reg); //a started DMA copy only makes progress in detailed mode
+	}else if (reg.memory_reference_load || reg.memory_reference_store) {
+		REUSE_ACCESS(reg.ALUOutput);
+	}
+	if (SAMPLE_WARM_CACHE && MMU_MODE != MMU_OFF && (reg.memory_reference_load || reg.memory_reference_store)) {
+		tlb_lookup(DTLB, reg.ALUOutput, FALSE);
+	}
+	if (reg.memory_reference_load && !SPM_CONTAINS(reg.ALUOutput) && !DMA_REGISTER(reg.ALUOutput)) {
+		if (SAMPLE_WARM_CACHE) {
+			warm_cache(reg.ALUOutput, FALSE);
+		}
+		reg.LMD = mem_read_32(reg.ALUOutput);
+		WATCH_ACCESS(reg.PC, reg.ALUOutput, reg.LMD, WATCH_READ);
+		if (reg.LLSC) {
+			CORES[CORE_ID].llValid = 1;
+			CORES[CORE_ID].llAddress = reg.ALUOutput;
+		}
+	}else if (reg.memory_reference_store && !SPM_CONTAINS(reg.ALUOutput) && !DMA_REGISTER(reg.ALUOutput)) {
+		if (reg.LLSC) {
+			reg.LMD = CORES[CORE_ID].llValid && CORES[CORE_ID].llAddress == reg.ALUOutput;
+			CORES[CORE_ID].llValid = 0;
+		}
+		if (!reg.LLSC || reg.LMD) {
+			if (SAMPLE_WARM_CACHE) {
+				warm_cache(reg.ALUOutput, TRUE);
+			}
+			mem_write_visible(reg.ALUOutput, reg.B); //keeps resident copies in sync
+			WATCH_ACCESS(reg.PC, reg.ALUOutput, reg.B, WATCH_WRITE);
+		}
+	}
+	writeback(&reg);
+	CURRENT_STATE = NEXT_STATE;
+	retire(&reg);
+	SAMPLE_FAST_INSTRUCTIONS++;
+}
+
+/***************************************************************/
+/* Functional warming: bring the block into L1Cache (and the replaced one into the   */
+/* victim buffer) without counting a hit or miss or spending any cycles                 */
+/***************************************************************/
+void warm_cache(uint32_t address, uint32_t store) {
+	int i, v;
+	uint32_t blockIndex = CACHE_INDEX(address);
+	uint32_t blockAddress = CACHE_BLOCK_ADDRESS(address);
+	CacheBlock *block = &L1Cache.blocks[blockIndex];
+	
+	if (block->valid && block->tag == CACHE_TAG(address)) {
+		if (store) {
+			block->state = MESI_MODIFIED;
+		}
+		return;
+	}
+	v = victim_lookup(blockAddress);
+	if (v >= 0) {
+		L1Cache.victimTags.valid[v] = 0; //moves back into the set below
+	}
+	victim_insert(blockIndex);
+	for (i = 0; i < WORD_PER_BLOCK; i++) {
+		block->words[i] = mem_read_32(blockAddress + (i * 4));
+	}
+	block->valid = 1;
+	block->tag = CACHE_TAG(address);
+	block->state = store ? MESI_MODIFIED : MESI_EXCLUSIVE;
+	block->prefetched = 0;
+	pollutedTag[blockIndex] = 0;
+}
+
+/***************************************************************/
+/* Sampled simulation: start over at the beginning of a unit                                    */
+/***************************************************************/
+void sample_reset() {
+	samplePhase = SAMPLE_FAST;
+	sampleDraining = FALSE;
+	samplePhaseStart = 0;
+	SAMPLE_UNITS = 0;
+	SAMPLE_FAST_INSTRUCTIONS = 0;
+	sampleCPISum = 0;
+	sampleCPISquares = 0;
+	sampleMissUnits = 0;
+	sampleMissSum = 0;
+	sampleMissSquares = 0;
+}
+
+/***************************************************************/
+/* Mean and 95% confidence half-width of n samples given their sum and sum of squares */
+/***************************************************************/
+void sample_interval(double sum, double squares, uint32_t n, double *mean, double *half) {
+	double variance;
+	
+	*mean = sum / n;
+	*half = 0;
+	if (n > 1) {
+		variance = (squares - sum * sum / n) / (n - 1);
+		*half = variance > 0 ? SAMPLE_Z * sqrt(variance / n) : 0;
+	}
+}
+
+/***************************************************************/
+/* Print the sampled estimates                                                                        */
+/***************************************************************/
+void print_sample_stats() {
+	double mean, half;
+	
+	printf("-------------------------------------\n");
+	printf("Sampling\t\t: %u units of %u instructions (%u warm-up, %u measured)%s\n", SAMPLE_UNITS, SAMPLE_PERIOD,
+		SAMPLE_WARMUP, SAMPLE_WINDOW, SAMPLE_WARM_CACHE ? ", cache warmed" : "");
+	printf("  fast-forwarded\t: %u instructions\n", SAMPLE_FAST_INSTRUCTIONS);
+	if (SAMPLE_UNITS == 0) {
+		printf("  no window measured yet\n");
+		return;
+	}
+	sample_interval(sampleCPISum, sampleCPISquares, SAMPLE_UNITS, &mean, &half);
+	printf("  estimated CPI\t\t: %.3f +/- %.3f (95%%)\n", mean, half);
+	printf("  estimated cycles\t: %.0f +/- %.0f\n", mean * INSTRUCTION_COUNT, half * INSTRUCTION_COUNT);
+	if (sampleMissUnits != 0) {
+		sample_interval(sampleMissSum, sampleMissSquares, sampleMissUnits, &mean, &half);
+		printf("  estimated miss rate\t: %.2f%% +/- %.2f%% (95%%)\n", 100 * mean, 100 * half);
+	}
+	if (SAMPLE_UNITS < 30) {
+		printf("  (fewer than 30 units, the intervals are rough)\n");
+	}
+}
+
+/***************************************************************/
+/* Set up sampled simulation, period 0 turns it off                                                */   
+/***************************************************************/
+void configure_sampling(uint32_t period, uint32_t warmup, uint32_t window, int warm_cache) {
+	if (period != 0 && (window < 1 || (uint64_t)warmup + window > period)){
+		printf("Invalid configuration (window >= 1, warm-up + window <= period, period 0 = off)\n");
+		return;
+	}
+	if (CYCLE_COUNT != 0 || INSTRUCTION_COUNT != 0){
+		printf("Program already started, reset before changing the sampling\n");
+		return;
 	}
-	printf("\nSimulation Finished.\n\n");
+	if (period != 0 && (OOO_MODE || CORE_COUNT > 1 || CHECKING)){
+		printf("Sampling only drives the single-core pipeline without the reference check\n");
+		return;
+	}
+	SAMPLE_PERIOD = period;
+	SAMPLE_WARMUP = warmup;
+	SAMPLE_WINDOW = window;
+	SAMPLE_WARM_CACHE = (warm_cache != 0);
+	sample_reset();
 }
 
 /***************************************************************/ 
@@ -152,925 +570,4735 @@ void rdump() {
 }
 
 /***************************************************************/
-/* Read a command from standard input.                                                               */  
+/* Dump cycle, instruction and cache statistics                                                       */   
 /***************************************************************/
-void handle_command() {                         
-	char buffer[20];
-	uint32_t start, stop, cycles;
-	//Clear IF_ID
-	uint32_t register_no;
-	int register_value;
-	int hi_reg_value, lo_reg_value;
-
-	printf("MU-MIPS SIM:> ");
-
-	if (scanf("%s", buffer) == EOF){
-		exit(0);
+void print_stats() {
+	uint32_t accesses = cache_hits + cache_misses;
+	
+	printf("-------------------------------------\n");
+	printf("Simulation Statistics\n");
+	printf("-------------------------------------\n");
+	printf("# Instructions Executed\t: %u\n", INSTRUCTION_COUNT);
+	printf("# Cycles Executed\t: %u\n", CYCLE_COUNT);
+	if (INSTRUCTION_COUNT != 0){
+		printf("CPI\t\t\t: %.3f\n", (double)CYCLE_COUNT / INSTRUCTION_COUNT);
 	}
-
-	switch(buffer[0]) {
-		case 'S':
-		case 's':
-			if (buffer[1] == 'h' || buffer[1] == 'H'){
-				show_pipeline();
-			}else {
-				runAll(); 
-			}
-			break;
-		case 'M':
-		case 'm':
-			if (scanf("%x %x", &start, &stop) != 2){
-				break;
-			}
-			mdump(start, stop);
-			break;ID_EX = IF_ID;
-		case '?':
-			help();
-			break;
-		case 'Q':
-		case 'q':
-			printf("**************************\n");
-			printf("Exiting MU-MIPS! Good Bye...\n");
-			printf("**************************\n");
-			exit(0);
-		case 'R':
-		case 'r':
-			if (buffer[1] == 'd' || buffer[1] == 'D'){
-				rdump();
-			}else if(buffer[1] == 'e' || buffer[1] == 'E'){
-				reset();
-			}
-			else {
-				if (scanf("%d", &cycles) != 1) {
-					break;
-				}
-				run(cycles);
-			}
-			break;
-		case 'I':
-		case 'i':
-			if (scanf("%u %i", &register_no, &register_value) != 2){
-				break;
-			}
-			CURRENT_STATE.REGS[register_no] = register_value;
-			NEXT_STATE.REGS[register_no] = register_value;
-			break;
-		case 'H':
-		case 'h':
-			if (scanf("%i", &hi_reg_value) != 1){
-				break;
-			}
-			CURRENT_STATE.HI = hi_reg_value; 
-			NEXT_STATE.HI = hi_reg_value; 
-			break;
-		case 'L':
-		case 'l':
-			if (scanf("%i", &lo_reg_value) != 1){
-				break;
-			}
-			CURRENT_STATE.LO = lo_reg_value;
-			NEXT_STATE.LO = lo_reg_value;
-			break;
-		case 'P':
-		case 'p':
-			print_program(); 
-			break;
-		default:
-			printf("Invalid Command.\n");
-			break;
-		case 'F':
-		case 'f':
-			if(scanf("%d", &ENABLE_FORWARDING) != 1){
-				break;
-			}
-			ENABLE_FORWARDING == 0 ? printf("Forwarding OFF\n") : printf("Forwarding ON\n");
-			break;
+	printf("Core model\t\t: %s\n", OOO_MODE ? "out-of-order" : (ISSUE_WIDTH == 2 ? "dual-issue pipeline" : "5-stage pipeline"));
+	if (CYCLE_SKIPPING){
+		printf("Stall cycles skipped\t: %u\n", SKIPPED_CYCLES);
+	}
+	printf("Branch resolution\t: %s, delay slot %s\n", BRANCH_IN_ID ? "ID" : "EX", DELAY_SLOT ? "on" : "off");
+	if (BRANCH_COUNT != 0){
+		printf("Branches/jumps\t\t: %u, %u taken (%.2f%%)\n", BRANCH_COUNT, BRANCH_TAKEN, 100.0 * BRANCH_TAKEN / BRANCH_COUNT);
+	}
+	printf("-------------------------------------\n");
+	printf("Cache hits\t\t: %u\n", cache_hits);
+	printf("Cache misses\t\t: %u\n", cache_misses);
+	if (accesses != 0){
+		printf("Cache hit rate\t\t: %.2f%%\n", 100.0 * cache_hits / accesses);
+	}
+	if (VICTIM_ENTRIES != 0){
+		printf("Victim buffer hits\t: %u (%d entries, %u cycle swap)\n", victim_hits, VICTIM_ENTRIES, VICTIM_HIT_PENALTY);
+		if (victim_hits + cache_misses != 0){
+			printf("Conflict misses caught\t: %.2f%%\n", 100.0 * victim_hits / (victim_hits + cache_misses));
+		}
+	}
+	if (FILL_MODE != FILL_WHOLE_BLOCK){
+		printf("Block fill\t\t: %s, %u cycles per word\n", FILL_MODE == FILL_CRITICAL_FIRST ? "critical word first" : "early restart", FILL_BEAT_CYCLES);
+		printf("  early restarts\t: %u, %u miss cycles saved\n", fill_early_restarts, fill_cycles_saved);
+		printf("  waits for a word\t: %u\n", fill_word_waits);
+		printf("  channel busy cycles\t: %u\n", fill_channel_waits);
+	}
+	if (store_buffer_stores != 0){
+		printf("Store buffer\t\t: %d entries, %u cycles per drain\n", STORE_BUFFER_SIZE, STORE_DRAIN_CYCLES);
+		printf("  avg occupancy\t\t: %.2f\n", CYCLE_COUNT ? (double)store_buffer_occupancy / CYCLE_COUNT : 0.0);
+		printf("  coalesced stores\t: %u of %u (%.2f%%)\n", store_buffer_coalesced, store_buffer_stores, 100.0 * store_buffer_coalesced / store_buffer_stores);
+		printf("  full stall cycles\t: %u\n", store_buffer_full_stalls);
+		printf("  forwarded to fills\t: %u\n", store_buffer_forwards);
+	}
+	if (CORE_COUNT > 1){
+		int i;
+		printf("-------------------------------------\n");
+		printf("%d cores, quantum %d cycles\n", CORE_COUNT, CORE_QUANTUM);
+		printf("[Core]\t[PC]\t\t[Instr]\t[Cycles]\t[Hits]\t[Misses]\t[BusRd]\t[BusRdX]\t[Upgr]\t[Inval]\t[Interv]\t[BusWaits]\n");
+		for (i = 0; i < CORE_COUNT; i++){
+			printf("%d\t0x%08x\t%u\t%u\t\t%u\t%u\t\t%u\t%u\t\t%u\t%u\t%u\t\t%u\n", i, CORES[i].state->PC, *CORES[i].instructions, *CORES[i].cycles,
+				*CORES[i].hits, *CORES[i].misses, CORES[i].busReads, CORES[i].busReadExclusives, CORES[i].busUpgrades,
+				CORES[i].invalidations, CORES[i].interventions, CORES[i].busWaits);
+		}
+	}
+	if (OOO_MODE){
+		printf("-------------------------------------\n");
+		printf("ROB size / width\t: %d / %d\n", OOO_ROB_SIZE, OOO_WIDTH);
+		printf("Avg ROB occupancy\t: %.2f\n", CYCLE_COUNT ? (double)OOO_ROB_OCCUPANCY / CYCLE_COUNT : 0.0);
+		printf("Cycles with a miss out\t: %u\n", OOO_MISS_CYCLES);
+		printf("Memory-level parallelism: %.2f\n", OOO_MISS_CYCLES ? (double)OOO_MISSES_OUTSTANDING / OOO_MISS_CYCLES : 0.0);
+		printf("MSHR merges\t\t: %u\n", OOO_MSHR_MERGES);
+		printf("Store-load forwards\t: %u\n", OOO_STORE_FORWARDS);
+		printf("Dispatch stalls\n");
+		printf("  ROB full\t\t: %u\n", OOO_ROB_FULL_STALLS);
+		printf("  RS full\t\t: %u\n", OOO_RS_FULL_STALLS);
+		printf("  LSQ full\t\t: %u\n", OOO_LSQ_FULL_STALLS);
+		printf("Issue stalls, MSHRs full: %u\n", OOO_MSHR_FULL_STALLS);
+	}
+	if (CHECKING){
+		printf("-------------------------------------\n");
+		printf("Reference check\t\t: %s, %u commits compared (batches of %d)\n", CHECK_FAILED ? "FAILED" : "ok", CHECKED_COMMITS, CHECK_BATCH);
+	}
+	if (MMU_MODE != MMU_OFF){
+		print_tlb_stats();
+	}
+	if (logRing != NULL){
+		print_log_stats();
+	}
+#ifdef HOST_PROFILE
+	print_host_profile();
+#endif
+	if (SPM_ON){
+		printf("-------------------------------------\n");
+		printf("Scratchpad\t\t: 0x%08x..0x%08x, %u loads, %u stores\n", SPM_BEGIN, SPM_BEGIN + SPM_SIZE - 1, SPM_LOADS, SPM_STORES);
+		printf("DMA copies\t\t: %u (%u words, %u busy cycles)%s\n", DMA_TRANSFERS, DMA_WORDS, DMA_BUSY_CYCLES, DMA.busy ? ", one running" : "");
+	}
+	if (CLASSIFY_MISSES){
+		print_miss_classes();
+	}
+	if (SAMPLE_PERIOD != 0){
+		print_sample_stats();
 	}
+	if (PREFETCH_MODE != PREFETCH_OFF){
+		printf("-------------------------------------\n");
+		printf("Prefetcher\t\t: %s, degree %d, distance %d\n", PREFETCH_MODE == PREFETCH_STRIDE ? "stride" : "next-line", PREFETCH_DEGREE, PREFETCH_DISTANCE);
+		printf("Prefetches issued\t: %u\n", prefetch_issued);
+		printf("  useful\t\t: %u\n", prefetch_useful);
+		printf("  late\t\t\t: %u\n", prefetch_late);
+		printf("  evicted unused\t: %u\n", prefetch_useless);
+		printf("Misses caused by prefetch: %u\n", prefetch_polluting);
+		if (prefetch_issued != 0){
+			printf("Accuracy\t\t: %.2f%%\n", 100.0 * (prefetch_useful + prefetch_late) / prefetch_issued);
+		}
+	}
+	if (ISSUE_WIDTH == 2){
+		printf("-------------------------------------\n");
+		printf("Dual-issue cycles\t: %u\n", DUAL_ISSUE_CYCLES);
+		printf("Single-issue cycles\t: %u\n", SINGLE_ISSUE_CYCLES);
+		printf("  dependent pair\t: %u\n", PAIR_DEPENDENCIES);
+		printf("  memory port\t\t: %u\n", PAIR_MEM_CONFLICTS);
+		printf("  MULT/DIV unit\t\t: %u\n", PAIR_MULDIV_CONFLICTS);
+		printf("  branch/jump/SYSCALL\t: %u\n", PAIR_CONTROL_BREAKS);
+	}
+	printf("-------------------------------------\n");
+	print_digest(FALSE);
+	printf("-------------------------------------\n");
 }
 
 /***************************************************************/
-/* reset registers/memory and reload program                                                    */
+/* Switch between the scalar and the dual-issue pipeline                                         */   
 /***************************************************************/
-void reset() {   
-	int i;
-	/*reset registers*/
-	for (i = 0; i < MIPS_REGS; i++){
-		CURRENT_STATE.REGS[i] = 0;
+void set_issue_width(int width) {
+	if (width == ISSUE_WIDTH){
+		return;
 	}
-	CURRENT_STATE.HI = 0;
-	CURRENT_STATE.LO = 0;
-	
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		uint32_t region_size = MEM_REGIONS[i].end - MEM_REGIONS[i].begin + 1;
-		memset(MEM_REGIONS[i].mem, 0, region_size);
+	if (BRANCH_IN_ID || DELAY_SLOT){
+		printf("Dual issue needs branches resolved in EX without a delay slot\n");
+		return;
 	}
-	
-	/*load program*/
-	load_program();
-	
-	/*reset PC*/
-	INSTRUCTION_COUNT = 0;
-	CURRENT_STATE.PC =  MEM_TEXT_BEGIN;
-	NEXT_STATE = CURRENT_STATE;
-	RUN_FLAG = TRUE;
+	//Instructions already in the second slot would be lost, so only switch on an empty pipeline
+	if (IF_ID_2.valid || ID_EX_2.valid || EX_MEM_2.valid || MEM_WB_2.valid){
+		printf("Pipeline is not empty, reset before switching issue width\n");
+		return;
+	}
+	ISSUE_WIDTH = width;
 }
 
 /***************************************************************/
-/* Allocate and set memory to zero                                                                            */
+/* Where branches are resolved (EX or ID) and whether they have a delay slot         */   
 /***************************************************************/
-void init_memory() {                                           
-	int i;
-	for (i = 0; i < NUM_MEM_REGION; i++) {
-		uint32_t region_size = MEM_REGIONS[i].end - MEM_REGIONS[i].begin + 1;
-		MEM_REGIONS[i].mem = malloc(region_size);
-    if(MEM_REGIONS[i].mem == NULL){
-      printf("\nMemory malloc failed!");
-     }
-		memset(MEM_REGIONS[i].mem, 0, region_size);
+void configure_branches(int in_id, int delay_slot) {
+	if (CYCLE_COUNT != 0 || INSTRUCTION_COUNT != 0){
+		printf("Program already started, reset before changing branch handling\n");
+		return;
 	}
+	if ((in_id || delay_slot) && ISSUE_WIDTH == 2){
+		printf("ID resolution and the delay slot need the scalar pipeline, turn dual issue off first\n");
+		return;
+	}
+	BRANCH_IN_ID = (in_id != 0);
+	DELAY_SLOT = (delay_slot != 0);
 }
 
-/**************************************************************/
-/* load program into memory                                                                                      */
-/**************************************************************/
-void load_program() {                   
-	FILE * fp;
-	int i, word;
-	uint32_t address;
+/***************************************************************/
+/* Switch between the pipeline and the out-of-order core model                                 */   
+/***************************************************************/
+void set_ooo_mode(int on) {
+	if ((on != 0) == OOO_MODE){
+		return;
+	}
+	if (CORE_COUNT > 1){
+		printf("The out-of-order model is single-core, set cores to 1 first\n");
+		return;
+	}
+	if (on && SPM_ON){
+		printf("The out-of-order model has no scratchpad, turn it off first\n");
+		return;
+	}
+	if (on && MMU_MODE != MMU_OFF){
+		printf("The out-of-order model has no MMU, turn it off first\n");
+		return;
+	}
+	//Neither model can take over the other one's in-flight instructions
+	if (CYCLE_COUNT != 0){
+		printf("Program already started, reset before switching core model\n");
+		return;
+	}
+	OOO_MODE = (on != 0);
+	ooo_reset();
+}
 
-	/* Open program file. */
-	fp = fopen(prog_file, "r");
-	if (fp == NULL) {
-		printf("Error: Can't open program file %s\n", prog_file);
-		exit(-1);
+/***************************************************************/
+/* Size the out-of-order core                                                                             */   
+/***************************************************************/
+void configure_ooo(int rob_size, int width, int alu_latency, int muldiv_latency, int mem_latency) {
+	if (robCount != 0){
+		printf("Out-of-order core is busy, reset before resizing it\n");
+		return;
+	}
+	if (rob_size < 1 || rob_size > MAX_ROB_SIZE || width < 1 || alu_latency < 1 || muldiv_latency < 1 || mem_latency < 1){
+		printf("Invalid configuration (ROB size 1..%d, width and latencies >= 1)\n", MAX_ROB_SIZE);
+		return;
 	}
+	OOO_ROB_SIZE = rob_size;
+	OOO_WIDTH = width;
+	OOO_UNITS[FU_ALU] = width;
+	OOO_LATENCY[FU_ALU] = alu_latency;
+	OOO_LATENCY[FU_MULDIV] = muldiv_latency;
+	OOO_LATENCY[FU_LS] = mem_latency;
+	ooo_reset();
+}
 
-	/* Read in the program. */
+/***************************************************************/
+/* Size the victim buffer behind the L1                                                                */   
+/***************************************************************/
+void configure_victim(int entries, int latency) {
+	if ((entries != 0 && entries < MIN_VICTIM_ENTRIES) || entries < 0 || entries > MAX_VICTIM_ENTRIES || latency < 1){
+		printf("Invalid configuration (0 = off, %d..%d entries, latency >= 1)\n", MIN_VICTIM_ENTRIES, MAX_VICTIM_ENTRIES);
+		return;
+	}
+	if (cacheStalling){
+		printf("Cache is busy with a miss, reset before resizing the victim buffer\n");
+		return;
+	}
+	VICTIM_ENTRIES = entries;
+	VICTIM_HIT_PENALTY = latency;
+	memset(L1Cache.victims, 0, sizeof(L1Cache.victims));
+	memset(&L1Cache.victimTags, 0, sizeof(L1Cache.victimTags));
+}
 
-	i = 0;
-	while( fscanf(fp, "%x\n", &word) != EOF ) {
-		address = MEM_TEXT_BEGIN + i;
-		mem_write_32(address, word);
-		printf("writing 0x%08x into address 0x%08x (%d)\n", word, address, address);
-		i += 4;
+/***************************************************************/
+/* MMU on (hardware walk or software refill, with its own refill cycles) or off      */   
+/***************************************************************/
+void configure_mmu(int mode, int latency) {
+	if (mode < MMU_OFF || mode > MMU_SOFTWARE_REFILL || latency < 1){
+		printf("Invalid configuration (0 = off, 1 = hardware page walk, 2 = software refill; refill cycles >= 1)\n");
+		return;
 	}
-	PROGRAM_SIZE = i/4;
-	printf("Program loaded into memory.\n%d words written into memory.\n\n", PROGRAM_SIZE);
-	fclose(fp);
+	if (mode != MMU_OFF && OOO_MODE){
+		printf("The MMU is modelled on the pipeline only, turn ooo off first\n");
+		return;
+	}
+	if (cacheStalling || itlbWalkPage != 0){
+		printf("Pipeline is waiting on memory, reset before changing the MMU\n");
+		return;
+	}
+	MMU_MODE = mode;
+	TLB_REFILL_CYCLES = latency;
 }
 
-/************************************************************/
-/* maintain the pipeline                                                                                           */ 
-/************************************************************/
-void handle_pipeline()
-{
-	/*INSTRUCTION_COUNT should be incremented when instruction is done*/
-	/*Since we do not have branch/jump instructions, INSTRUCTION_COUNT should be incremented in WB stage */
-	
-	WB();
-	MEM();
-	EX();
-	ID();
-	IF();
+/***************************************************************/
+/* Size the I-TLB or the D-TLB                                                                             */   
+/***************************************************************/
+void configure_tlb(int which, int entries, int ways) {
+	if (entries < 1 || entries > MAX_TLB_ENTRIES || ways < 1 || entries % ways != 0){
+		printf("Invalid configuration (1..%d entries, a multiple of the ways)\n", MAX_TLB_ENTRIES);
+		return;
+	}
+	TLB_ENTRIES[which] = entries;
+	TLB_WAYS[which] = ways;
+	memset(&TLBS[which], 0, sizeof(TLBS[which])); //entries are placed by set
 }
 
-/************************************************************/
-/* writeback (WB) pipeline stage:                                                                          */ 
-/************************************************************/
-void WB()
-{
-  //if cache is stalling, skip
-  if(cacheStalling != 0){
-    return;
-  }
-  
-	uint32_t rd, rt, rs;
-	rd = MEM_WB.IR & 0xF800;
-	rd >>= 11; 
-	rt = MEM_WB.IR & 0x1F0000;
-	rt >>= 16;
-	rs = MEM_WB.IR & 0x3E00000;
-	rs >>= 21;
-	
-	if(MEM_WB.memory_reference_load){
-    printf("WB_MEMWB DEST: %x    MEMWB LMD: %x",MEM_WB.destination, MEM_WB.LMD);
-		NEXT_STATE.REGS[MEM_WB.destination] = MEM_WB.LMD;
-    printf("WB_NEXT STATE REG VALUE: %x", NEXT_STATE.REGS[MEM_WB.destination]);
+/***************************************************************/
+/* Map the scratchpad window (and the DMA registers) in or out                               */   
+/***************************************************************/
+void configure_scratchpad(int on, uint32_t begin, uint32_t size) {
+	if (on && (begin & 3 || size == 0 || size & 3 || size > MAX_SPM_SIZE || begin < MEM_DATA_BEGIN || begin - 1 + size > MEM_DATA_END ||
+		(begin < DMA_END && begin + size > DMA_BASE))){
+		printf("Invalid configuration (word-aligned window of up to %d bytes in the data region, clear of the DMA registers at 0x%08x)\n", MAX_SPM_SIZE, DMA_BASE);
+		return;
 	}
-	if(MEM_WB.register_register){
-		NEXT_STATE.REGS[MEM_WB.destination] = MEM_WB.ALUOutput;
+	if (on && (CORE_COUNT > 1 || OOO_MODE)){
+		printf("The scratchpad is modelled on the single-core pipeline only\n");
+		return;
 	}
-	if(MEM_WB.register_immediate){
-		NEXT_STATE.REGS[rt] = MEM_WB.ALUOutput;
+	if (DMA.busy){
+		printf("DMA copy in progress, reset before remapping the scratchpad\n");
+		return;
 	}
-	if(MEM_WB.MFHI){
-		NEXT_STATE.REGS[MEM_WB.destination] = CURRENT_STATE.HI;
+	//stores already buffered for the window have to reach memory, MEM() will not look there
+	store_buffer_drain(&storeBuffer, storeBuffer.count);
+	SPM_ON = (on != 0);
+	if (on){
+		SPM_BEGIN = begin;
+		SPM_SIZE = size;
 	}
-	if(MEM_WB.MTHI){
-		NEXT_STATE.HI = CURRENT_STATE.REGS[rs];
+}
+
+/***************************************************************/
+/* DMA engine timing                                                                                        */   
+/***************************************************************/
+void configure_dma(int setup, int word_cycles) {
+	if (setup < 0 || word_cycles < 1){
+		printf("Invalid configuration (setup >= 0, cycles per word >= 1)\n");
+		return;
+	}
+	DMA_SETUP_CYCLES = setup;
+	DMA_WORD_CYCLES = word_cycles;
+}
+
+/***************************************************************/
+/* Order (and speed) a missed block comes back from memory in                             */   
+/***************************************************************/
+void configure_fill(int mode, int beat) {
+	if (mode < FILL_WHOLE_BLOCK || mode > FILL_CRITICAL_FIRST || beat < 1 || beat > (CACHE_MISS_PENALTY - 1) / (WORD_PER_BLOCK - 1)){
+		printf("Invalid configuration (0 = whole block, 1 = early restart, 2 = critical word first; 1..%d cycles per word)\n",
+			(CACHE_MISS_PENALTY - 1) / (WORD_PER_BLOCK - 1));
+		return;
 	}
-	if(MEM_WB.MFLO){
-		NEXT_STATE.REGS[MEM_WB.destination] = CURRENT_STATE.LO;
+	if (cacheStalling){
+		printf("Cache is busy with a miss, reset before changing the fill order\n");
+		return;
 	}
-	if(MEM_WB.MTLO){
-		NEXT_STATE.LO = CURRENT_STATE.REGS[rs];
+	FILL_MODE = mode;
+	FILL_BEAT_CYCLES = beat;
+	memset(&blockFill, 0, sizeof(blockFill));
+}
+
+/***************************************************************/
+/* Size the store buffer and its drain bandwidth                                                   */   
+/***************************************************************/
+void configure_store_buffer(int entries, int drain_cycles) {
+	if (entries < 1 || entries > MAX_STORE_BUFFER || drain_cycles < 1){
+		printf("Invalid configuration (1..%d entries, drain cycles >= 1)\n", MAX_STORE_BUFFER);
+		return;
 	}
-	if(MEM_WB.MULDIV){
-		NEXT_STATE.LO = MEM_WB.LO;
-		NEXT_STATE.HI = MEM_WB.HI;
+	if (storeBuffer.count != 0 || cacheStalling){
+		printf("Store buffer is busy, reset before resizing it\n");
+		return;
 	}
-	
-	INSTRUCTION_COUNT++;
+	STORE_BUFFER_SIZE = entries;
+	STORE_DRAIN_CYCLES = drain_cycles;
 }
 
-/************************************************************/
-/* memory access (MEM) pipeline stage:                                                          */ 
-/************************************************************/
-void MEM()
-{
-  int i;
-  /*uint32_t currentTag = MEM_WB.ALUOutput & 0xFFFFF000;
-  uint32_t byteOffset = MEM_WB.ALUOutput & 0x3;
-  uint32_t wordOffset = MEM_WB.ALUOutput & 0xC;
-  uint32_t blockIndex = MEM_WB.ALUOutput & 0xF0;
-  uint32_t blockAddress = MEM_WB.ALUOutput & 0xFFFFFFFC;*/
-  
-  uint32_t currentTag = (MEM_WB.ALUOutput & 0xFFFFFFC0) >> 6;
-  //uint32_t byteOffset = MEM_WB.ALUOutput & 0x3;
-  uint32_t wordOffset = (MEM_WB.ALUOutput & 0x3);
-  uint32_t blockIndex = (MEM_WB.ALUOutput & 0x3C) >> 2;
-  uint32_t blockAddress = MEM_WB.ALUOutput & 0xFFFFFFFC;
-  
-  if(cacheStalling==0){
-    //not stalling
-    MEM_WB = EX_MEM;
-	  memset(&EX_MEM, 0, sizeof(EX_MEM)); //Clear EX_MEM
-    //skip if no memory load/store
-    if(!(MEM_WB.memory_reference_load || MEM_WB.memory_reference_store)){
-      return;
-    }
-    
-    uint32_t currentTag = (MEM_WB.ALUOutput & 0xFFFFFFC0) >> 6;
-    //uint32_t byteOffset = MEM_WB.ALUOutput & 0x3;
-    uint32_t wordOffset = (MEM_WB.ALUOutput & 0x3);
-    uint32_t blockIndex = (MEM_WB.ALUOutput & 0x3C) >> 2;
-    uint32_t blockAddress = MEM_WB.ALUOutput & 0xFFFFFFFC;
-    //CacheBlock* currentBlock;
-    //currentBlock = &L1Cache.blocks[blockIndex];
-    //HIT MISS LOGIC//
-    //Look in cache at block[blockIndex]
-      //compare tags
-      //check valid bit
-        //hit/miss
-    
-    //HIT//
-      //Load
-        //Give cpu value cache[blockIndex].words[wordOffset]
-      //Store
-        //Update the value at cache[blockIndex].words[wordOffset]
-        //Place cache[blockIndex] into writeBuffer
-        //Write writeBuffer to memory (need four writes)
-    
-    
-    //MISS//
-      //Stall 100 cycles
-      //Load
-        //Read block from memory
-          //Read four times from memory (address = blockAddress)
-          //Place values into cache[blockIndex].words[0,1,2,3]
-          //Set cache[blockIndex].valid bit
-          //Set cache[blockIndex].tag
-          //return value to cpu
-      //Store
-        //Read block from memory
-          //Read four times from memory (address = blockAddress)
-          //Place values into cache[blockIndex].words[0,1,2,3]
-          //Set cache[blockIndex].valid bit
-          //Set cache[blockIndex].tag
-        //Update the value at cache[blockIndex].words[wordOffset]
-        //Place cache[blockIndex] into writeBuffer
-        //Write writeBuffer to memory (need four writes)
-    
-  
-   
-    /*
-    printf("\nAfter block set");
-    printf("\ncurrentBlock.tag : %x ", (*currentBlock).tag);
-    printf("\ncurrentBlock.valid: %x", (*currentBlock).valid);
-    printf("\ncurrentTag: %x", currentTag);
-    */
-    
-    //HIT MISS LOGIC//
-    if((L1Cache.blocks[blockIndex].tag == currentTag) && (L1Cache.blocks[blockIndex].valid == 1)){
-      printf("\nCACHE Hit!");
-      //cache hit, so load/store from cache
-      cache_hits++;
-      
-      if(MEM_WB.memory_reference_load){
-        printf("\nCACHE Memory Load");
-        MEM_WB.LMD = L1Cache.blocks[blockIndex].words[wordOffset];
-        //printf("\nCACHE_MEMWB LMD: %x", MEM_WB.LMD);
-      } else if(MEM_WB.memory_reference_store){
-        printf("\nCACHE Memory Store");
-        L1Cache.blocks[blockIndex].words[wordOffset] = MEM_WB.B; //update cache
-        
-        fflush(stdout);
-        
-        //put cache block into write buffer
-        writeBuffer.words[0] = L1Cache.blocks[blockIndex].words[0]; 
-        writeBuffer.words[1] = L1Cache.blocks[blockIndex].words[1];
-        writeBuffer.words[2] = L1Cache.blocks[blockIndex].words[2];
-        writeBuffer.words[3] = L1Cache.blocks[blockIndex].words[3];
-        
-        writeBufferToMemory(blockAddress); //write write buffer to memory
-      }
-    } else {
-      printf("\nCACHE Miss!");
-      fflush(stdout);
-      //cache miss, start stalling
-      cacheStalling++;
-      cache_misses++;
-    }
-    
-  } else {
-    //MISS//
- 
-    if(cacheStalling == 100){
-      //end of cache stalling
-      //printf("\nEnd of stalling! memLoad: %d   memStore: %d", MEM_WB.memory_reference_load, MEM_WB.memory_reference_store);
-      //fflush(stdout);
-      cacheStalling = 0;
-      stalling = 0;
-      
-      if(MEM_WB.memory_reference_load){
-        printf("\nCACHE Memory Load");
-        fflush(stdout);
-        //read all words in block and place each into cache
-        L1Cache.blocks[blockIndex].words[0] = mem_read_32(blockAddress);
-        L1Cache.blocks[blockIndex].words[1] = mem_read_32(blockAddress+0x1);
-        L1Cache.blocks[blockIndex].words[2] = mem_read_32(blockAddress+0x2);
-        L1Cache.blocks[blockIndex].words[3] = mem_read_32(blockAddress+0x3);
-        
-        L1Cache.blocks[blockIndex].valid = 1; //block is now valid
-        L1Cache.blocks[blockIndex].tag = currentTag;
-        
-        MEM_WB.LMD = L1Cache.blocks[blockIndex].words[wordOffset]; //return word to CPU
-        //printf("\nCACHE_MEMWB LMD: %x", MEM_WB.LMD);
-
-      } else if(MEM_WB.memory_reference_store){
-        printf("\nCACHE Memory Store");
-        fflush(stdout);
-        
-         //read all words in block and place each into cache
-        L1Cache.blocks[blockIndex].words[0] = mem_read_32(blockAddress);
-        L1Cache.blocks[blockIndex].words[1] = mem_read_32(blockAddress+0x1);
-        L1Cache.blocks[blockIndex].words[2] = mem_read_32(blockAddress+0x2);
-        L1Cache.blocks[blockIndex].words[3] = mem_read_32(blockAddress+0x3);
-        
-        L1Cache.blocks[blockIndex].valid = 1; //block is now valid
-        L1Cache.blocks[blockIndex].tag = currentTag;
-        
-        L1Cache.blocks[blockIndex].words[wordOffset] = MEM_WB.B; //update new word in cache
-        printf("\njust put %x into cache block %x at word index %x", MEM_WB.B, blockIndex, wordOffset); 
-      cacheStalling++;
-    }
-  }
+/***************************************************************/
+/* Select and tune the data prefetcher                                                                 */   
+/***************************************************************/
+void configure_prefetch(int mode, int degree, int distance) {
+	if (mode < PREFETCH_OFF || mode > PREFETCH_STRIDE || degree < 1 || distance < 1){
+		printf("Invalid configuration (mode 0 = off, 1 = next-line, 2 = stride; degree and distance >= 1)\n");
+		return;
+	}
+	PREFETCH_MODE = mode;
+	PREFETCH_DEGREE = degree;
+	PREFETCH_DISTANCE = distance;
+	prefetch_reset();
 }
 
-/************************************************************/
-/* execution (EX) pipeline stage:                                                                          */ 
-/************************************************************/
-void EX()
-{
-	if(cacheStalling != 0){
-    return;
-  }
-  
-	uint64_t product, p1, p2;
-	EX_MEM = ID_EX;
-	memset(&ID_EX, 0, sizeof(ID_EX)); //Clear ID_EX
-	EX_MEM.memory_reference_load = 0;
-	EX_MEM.memory_reference_store = 0;
-	EX_MEM.register_register = 0;
-	EX_MEM.register_immediate = 0;
-	EX_MEM.MFHI = 0; 
-	EX_MEM.MTHI = 0; 
-	EX_MEM.MFLO = 0;
-	EX_MEM.MTLO = 0;
-	EX_MEM.MULDIV = 0;
-	EX_MEM.RegWrite = 0;
-
-	if(EX_MEM.opcode == 0x00 && EX_MEM.IR != 0x00){
-		switch(EX_MEM.function){
-				case 0x00:{ //SLL
-					uint32_t sa = EX_MEM.imm & 0x07C0;
-					sa = sa >> 6;
-					EX_MEM.ALUOutput = EX_MEM.B << sa;
+/***************************************************************/
+/* Run one command line from the shell (or mumips_command()).                                                               */  
+/***************************************************************/
+int handle_command(const char *line) {                         
+	char buffer[20];
+	uint32_t start, stop, cycles;
+	//Clear IF_ID
+	uint32_t register_no;
+	int register_value;
+	int hi_reg_value, lo_reg_value;
+	int dual_issue;
+	int ooo_mode, rob_size, width, alu_latency, muldiv_latency, mem_latency;
+	int cores, quantum;
+	int prefetch_mode, degree, distance;
+	int victim_entries, victim_latency;
+	int sb_entries, drain_cycles;
+	char watch_type[4];
+	uint32_t watch_value;
+	int check_on, check_batch;
+	int profile_on, profile_top;
+	int reuse_on, classify_on;
+	int branch_in_id, delay_slot;
+	int fill_mode, fill_beat;
+	int spm_on, dma_setup, dma_word_cycles;
+	int mmu_mode, tlb_latency, tlb_entries, tlb_ways;
+	char tlb_side;
+	char log_category[16], log_path[256];
+	int log_level;
+	uint32_t spm_begin, spm_size;
+	uint32_t reuse_window;
+	uint32_t period, warmup, window;
+	int warm;
+	const char *args;
+	int length;
 
-					EX_MEM.destination = EX_MEM.registerRd;
-					
-					EX_MEM.register_register = 1;
+	if (sscanf(line, "%19s%n", buffer, &length) != 1){
+		return MUMIPS_OK; //blank line
+	}
+	args = line + length;
+
+	switch(buffer[0]) {
+		case 'S':
+		case 's':
+			if (strcmp(buffer, "skip") == 0){
+				if (sscanf(args, "%d", &CYCLE_SKIPPING) != 1){
 					break;
 				}
-				case 0x02:{ //SRL
-					uint32_t sa = EX_MEM.imm & 0x07C0;
-					sa = sa >> 6;
-					EX_MEM.ALUOutput = EX_MEM.B >> sa;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
+				CYCLE_SKIPPING ? printf("Stall cycle skipping ON\n") : printf("Stall cycle skipping OFF\n");
+			}else if (strcmp(buffer, "sample") == 0){
+				if (sscanf(args, "%u %u %u %d", &period, &warmup, &window, &warm) != 4){
 					break;
 				}
-				case 0x03:{ //SRA 
-					uint32_t sa = EX_MEM.imm & 0x07C0;
-					sa = sa >> 6;
-					if ((sa & 0x10) == 1)
-					{
-						EX_MEM.ALUOutput =  ~(~EX_MEM.B >> sa);
-					}
-					else{
-						EX_MEM.ALUOutput = EX_MEM.B >> sa;
-					}
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
+				configure_sampling(period, warmup, window, warm);
+				SAMPLE_PERIOD ? printf("Sampling ON, %u warm-up + %u measured instructions every %u\n", SAMPLE_WARMUP, SAMPLE_WINDOW, SAMPLE_PERIOD) : printf("Sampling OFF\n");
+			}else if (strcmp(buffer, "scratchpad") == 0){
+				if (sscanf(args, "%d %x %u", &spm_on, &spm_begin, &spm_size) != 3){
 					break;
 				}
-				case 0x0C: //SYSCALL
-					if(CURRENT_STATE.REGS[2] == 0xa){
-						RUN_FLAG = FALSE;
-					}
-					break;
-				case 0x10: //MFHI *******LOAD/STORE********* HI -> rd
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.MFHI = 1;
-					break;
-				case 0x11: //MTHI *******LOAD/STORE********* rs -> HI
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MTHI = 1;
-					break;
-				case 0x12: //MFLO *******LOAD/STORE********* LO -> rd
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.MFLO = 1;
+				configure_scratchpad(spm_on, spm_begin, spm_size);
+				SPM_ON ? printf("Scratchpad ON at 0x%08x..0x%08x, DMA registers at 0x%08x\n", SPM_BEGIN, SPM_BEGIN + SPM_SIZE - 1, DMA_BASE) : printf("Scratchpad OFF\n");
+			}else if (strcmp(buffer, "storebuffer") == 0){
+				if (sscanf(args, "%d %d", &sb_entries, &drain_cycles) != 2){
 					break;
-				case 0x13: //MTLORegWrite *******LOAD/STORE********* rs -> LO
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MTLO = 1;
+				}
+				configure_store_buffer(sb_entries, drain_cycles);
+			}else if (buffer[1] == 'h' || buffer[1] == 'H'){
+				show_pipeline();
+			}else if (buffer[1] == 't' || buffer[1] == 'T'){
+				print_stats();
+			}else if (buffer[1] == 'u' || buffer[1] == 'U'){
+				if (sscanf(args, "%d", &dual_issue) != 1){
 					break;
-				case 0x18: //MULT
-					if ((EX_MEM.A & 0x80000000) == 0x80000000){
-						p1 = 0xFFFFFFFF00000000 | EX_MEM.A;
-					}else{
-						p1 = 0x00000000FFFFFFFF & EX_MEM.A;
-					}
-					if ((EX_MEM.B & 0x80000000) == 0x80000000){
-						p2 = 0xFFFFFFFF00000000 | EX_MEM.B;
-					}else{
-						p2 = 0x00000000FFFFFFFF & EX_MEM.B;
-					}
-					product = p1 * p2;
-					EX_MEM.LO = (product & 0X00000000FFFFFFFF);
-					EX_MEM.HI = (product & 0XFFFFFFFF00000000)>>32;
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MULDIV = 1;
+				}
+				set_issue_width(dual_issue ? 2 : 1);
+				ISSUE_WIDTH == 2 ? printf("Dual-issue ON\n") : printf("Dual-issue OFF\n");
+			}else {
+				runAll(); 
+			}
+			break;
+		case 'M':
+		case 'm':
+			if (strcmp(buffer, "mmu") == 0){
+				if (sscanf(args, "%d %d", &mmu_mode, &tlb_latency) != 2){
 					break;
-				case 0x19: //MULTU
-					product = (uint64_t)EX_MEM.A * (uint64_t)EX_MEM.B;
-					EX_MEM.LO = (product & 0X00000000FFFFFFFF);
-					EX_MEM.HI = (product & 0XFFFFFFFF00000000)>>32;
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MULDIV = 1;
+				}
+				configure_mmu(mmu_mode, tlb_latency);
+				MMU_MODE != MMU_OFF ? printf("MMU ON, %s, %u refill cycles plus page table reads\n", MMU_MODE == MMU_HARDWARE_WALK ? "hardware page walk" : "software refill", TLB_REFILL_CYCLES) : printf("MMU OFF\n");
+				break;
+			}
+			if (strcmp(buffer, "misses") == 0){
+				if (sscanf(args, "%d", &classify_on) != 1){
 					break;
-				case 0x1A: //DIV 
-					if(EX_MEM.B != 0)
-					{
-						EX_MEM.LO = (int32_t)EX_MEM.A / (int32_t)EX_MEM.B;
-						EX_MEM.HI = (int32_t)EX_MEM.A % (int32_t)EX_MEM.B;
-					}
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MULDIV = 1;
+				}
+				set_classify_misses(classify_on);
+				CLASSIFY_MISSES ? printf("Miss classification ON\n") : printf("Miss classification OFF\n");
+				break;
+			}
+			if (sscanf(args, "%x %x", &start, &stop) != 2){
+				break;
+			}
+			mdump(start, stop);
+			break;ID_EX = IF_ID;
+		case '?':
+			help();
+			break;
+		case 'Q':
+		case 'q':
+			printf("**************************\n");
+			printf("Exiting MU-MIPS! Good Bye...\n");
+			printf("**************************\n");
+			return MUMIPS_QUIT;
+		case 'R':
+		case 'r':
+			if (strcmp(buffer, "reuse") == 0){
+				if (sscanf(args, "%d %u", &reuse_on, &reuse_window) != 2){
+					print_reuse();
 					break;
-				case 0x1B: //DIVU
-					if(EX_MEM.B != 0)
-					{
-						EX_MEM.LO = (int32_t)EX_MEM.A / (int32_t)EX_MEM.B;
-						EX_MEM.HI = (int32_t)EX_MEM.A % (int32_t)EX_MEM.B;
-					}
-					EX_MEM.destination = 32; //32 represents LO/HI registers as destination
-					EX_MEM.MULDIV = 1;
+				}
+				set_reuse(reuse_on, reuse_window);
+				REUSE_ON ? printf("Reuse analyzer ON, working set per %u instructions\n", REUSE_WINDOW) : printf("Reuse analyzer OFF\n");
+			}else if (buffer[1] == 'd' || buffer[1] == 'D'){
+				rdump();
+			}else if(buffer[1] == 'e' || buffer[1] == 'E'){
+				reset();
+				printf("Program loaded into memory.\n%d words written into memory.\n\n", PROGRAM_SIZE);
+			}
+			else {
+				if (sscanf(args, "%d", &cycles) != 1) {
 					break;
-				case 0x20: //ADD
-					EX_MEM.ALUOutput = EX_MEM.A + EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
+				}
+				run(cycles);
+			}
+			break;
+		case 'I':
+		case 'i':
+			if (sscanf(args, "%u %i", &register_no, &register_value) != 2){
+				break;
+			}
+			CURRENT_STATE.REGS[register_no] = register_value;
+			NEXT_STATE.REGS[register_no] = register_value;
+			break;
+		case 'H':
+		case 'h':
+			if (sscanf(args, "%i", &hi_reg_value) != 1){
+				break;
+			}
+			CURRENT_STATE.HI = hi_reg_value; 
+			NEXT_STATE.HI = hi_reg_value; 
+			break;
+		case 'L':
+		case 'l':
+			if (strcmp(buffer, "log") == 0){
+				if (sscanf(args, "%15s %d", log_category, &log_level) != 2){
+					print_log_stats();
 					break;
-				case 0x21: //ADDU 
-					EX_MEM.ALUOutput = EX_MEM.A + EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
+				}
+				configure_logging(log_category, log_level);
+				break;
+			}
+			if (strcmp(buffer, "logfile") == 0){
+				if (sscanf(args, "%255s", log_path) != 1){
 					break;
-				case 0x22: //SUB
-					EX_MEM.ALUOutput = EX_MEM.A - EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x23: //SUBU
-					EX_MEM.ALUOutput = EX_MEM.A - EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x24: //AND
-					EX_MEM.ALUOutput = EX_MEM.A & EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x25: //OR
-					EX_MEM.ALUOutput = EX_MEM.A | EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x26: //XOR
-					EX_MEM.ALUOutput = EX_MEM.A ^ EX_MEM.B;
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x27: //NOR
-					EX_MEM.ALUOutput = ~(EX_MEM.A | EX_MEM.B);
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x2A: //SLT
-					if((EX_MEM.A & 0x80000000) == 0x80000000 && (EX_MEM.B & 0x80000000) == 0x80000000){  //Negative comparison
-						if(EX_MEM.A < EX_MEM.B){
-							//set
-							EX_MEM.ALUOutput = 0x1;
-						}else{
-							//clear
-							EX_MEM.ALUOutput = 0x0;
-						}
-					}else if((EX_MEM.A & 0x80000000) == 0 && (EX_MEM.B & 0x80000000) == 0){    //Positive compare
-						if(EX_MEM.A < EX_MEM.B){
-							//set
-							EX_MEM.ALUOutput = 0x1;
-						}else{
-							//clear
-							EX_MEM.ALUOutput = 0x0;
-						}
-					}else if((EX_MEM.A & 0x80000000) == 0 && (EX_MEM.B & 0x80000000) == 0x80000000){ //A positive, imm negative
-						//clear
-						EX_MEM.ALUOutput = 0x0;
-					}else{ //A negative. imm positive
-						//set
-						EX_MEM.ALUOutput = 0x1;
-					}
-				
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					break;
-				case 0x9: //JALR
-					NEXT_STATE.PC = EX_MEM.A;
-					EX_MEM.ALUOutput = CURRENT_STATE.PC + 4; //address of next instruction
-					EX_MEM.destination = EX_MEM.registerRd;
-					EX_MEM.register_register = 1;
-					flush();
-					break;
-				case 0x8: //JR
-					NEXT_STATE.PC = EX_MEM.A;
-					flush();
-					break;
-				default:
-					printf("Instruction at is not implemented!\n");
-					break;
-			}	
-	}else if(EX_MEM.opcode == 0x1 && EX_MEM.IR != 0x00){
-		//All special branches here... assuming the 'special' value for
-		//other instructions is never 0x1
-		
-		//New switch for special branches
-		switch(EX_MEM.registerRt){
-			case 0x1: //BGEZ
-				if((EX_MEM.A & 0x80000000) == 0){
-					NEXT_STATE.PC = (CURRENT_STATE.PC + EX_MEM.imm) << 2;
-					flush();
-				}
-				break;
-			case 0x0: //BLTZ
-				if((EX_MEM.A & 0x80000000) == 0x80000000){
-					NEXT_STATE.PC = (CURRENT_STATE.PC + EX_MEM.imm) << 2;
-					flush();
 				}
+				set_log_file(log_path);
 				break;
-			default:
-					printf("\nCould not find the correct instruction! Special Branches");
+			}
+			if (sscanf(args, "%i", &lo_reg_value) != 1){
 				break;
-		}
-	}else if(EX_MEM.IR != 0x00){
-		switch(EX_MEM.opcode){
-			case 0x08: //ADDI
-				EX_MEM.ALUOutput = EX_MEM.A + ( (EX_MEM.imm & 0x8000) > 0 ? (EX_MEM.imm | 0xFFFF0000) : (EX_MEM.imm & 0x0000FFFF));
-				EX_MEM.destination = EX_MEM.registerRt;
-				EX_MEM.register_immediate = 1;
+			}
+			CURRENT_STATE.LO = lo_reg_value;
+			NEXT_STATE.LO = lo_reg_value;
+			break;
+		case 'P':
+		case 'p':
+			if (strcmp(buffer, "prefetch") == 0){
+				if (sscanf(args, "%d %d %d", &prefetch_mode, &degree, &distance) != 3){
+					break;
+				}
+				configure_prefetch(prefetch_mode, degree, distance);
 				break;
-			case 0x09: //ADDIU	instruction = IF_ID.IR ;
-				EX_MEM.ALUOutput = EX_MEM.A + ( (EX_MEM.imm & 0x8000) > 0 ? (EX_MEM.imm | 0xFFFF0000) : (EX_MEM.imm & 0x0000FFFF));
-				EX_MEM.destination = EX_MEM.registerRt;
-				//printf("\nEX MEM DEST : %x", EX_MEM.destination);
-				EX_MEM.register_immediate = 1;
-				//printf("\nEX_MEM.Destination after set: %d", EX_MEM.destination);
+			}
+			if (strcmp(buffer, "profile") == 0){
+				if (sscanf(args, "%d %d", &profile_on, &profile_top) != 2){
+					print_profile();
+					break;
+				}
+				set_profiling(profile_on, profile_top);
+				PROFILE_DATA ? printf("Profiling ON, top %d\n", PROFILE_TOP) : printf("Profiling OFF\n");
 				break;
-			case 0x0A: //SLTI
-				if((EX_MEM.A & 0x80000000) == 0x80000000 && (EX_MEM.imm & 0x80000000) == 0x80000000){  //Negative comparison
-					if(EX_MEM.A < EX_MEM.imm){
-						//set
-						EX_MEM.ALUOutput = 0x1;
-					}else{
-						//clear
-						EX_MEM.ALUOutput = 0x0;
-					}
-				}else if((EX_MEM.A & 0x80000000) == 0 && (EX_MEM.imm & 0x80000000) == 0){    //Positive compare
-					if(EX_MEM.A < EX_MEM.imm){
-						//set
-						EX_MEM.ALUOutput = 0x1;
-					}else{
-						//clear
-						EX_MEM.ALUOutput = 0x0;
-					}
-				}else if((EX_MEM.A & 0x80000000) == 0 && (EX_MEM.imm & 0x80000000) == 0x80000000){ //A positive, imm negative
-					//clear
-					EX_MEM.ALUOutput = 0x0;
-				}else{ //A negative. imm positive
-					//set
-					EX_MEM.ALUOutput = 0x1;
+			}
+			print_program(); 
+			break;
+		default:
+			printf("Invalid Command.\n");
+			break;
+		case 'C':
+		case 'c':
+			if (strcmp(buffer, "check") == 0){
+				if (sscanf(args, "%d %d", &check_on, &check_batch) != 2){
+					break;
 				}
-				
-				EX_MEM.destination = EX_MEM.registerRt;
-				EX_MEM.register_immediate = 1;
+				set_checking(check_on, check_batch);
+				CHECKING ? printf("Reference check ON, batches of %d commits\n", CHECK_BATCH) : printf("Reference check OFF\n");
 				break;
-			case 0x0C: //ANDI
-				EX_MEM.ALUOutput = EX_MEM.A & (EX_MEM.imm & 0x0000FFFF);
-				EX_MEM.destination = EX_MEM.registerRt;
-				EX_MEM.register_immediate = 1;
+			}
+			if (sscanf(args, "%d %d", &cores, &quantum) != 2){
 				break;
-			case 0x0D: //ORI
-				EX_MEM.ALUOutput = EX_MEM.A | (EX_MEM.imm & 0x0000FFFF);
-				EX_MEM.destination = EX_MEM.registerRt;
-				EX_MEM.register_immediate = 1;
+			}
+			start_cores(cores, quantum);
+			printf("%d core(s), quantum %d cycles\n", CORE_COUNT, CORE_QUANTUM);
+			break;
+		case 'O':
+		case 'o':
+			if (strcmp(buffer, "oooconfig") == 0){
+				if (sscanf(args, "%d %d %d %d %d", &rob_size, &width, &alu_latency, &muldiv_latency, &mem_latency) != 5){
+					break;
+				}
+				configure_ooo(rob_size, width, alu_latency, muldiv_latency, mem_latency);
+			}else {
+				if (sscanf(args, "%d", &ooo_mode) != 1){
+					break;
+				}
+				set_ooo_mode(ooo_mode);
+				OOO_MODE ? printf("Out-of-order core ON\n") : printf("Out-of-order core OFF\n");
+			}
+			break;
+		case 'B':
+		case 'b':
+			if (strcmp(buffer, "breaks") == 0){
+				list_debug_points();
 				break;
-			case 0x0E: //XORI
-				//printf("\nXORI");
-				//printf("\nEXMEM A : %x\n", EX_MEM.A);
-				EX_MEM.ALUOutput = EX_MEM.A ^ (EX_MEM.imm & 0x0000FFFF);
-				//printf("\nEXMEM ALU: %x", EX_MEM.ALUOutput);
-				EX_MEM.destination = EX_MEM.registerRt;
-				//printf("\nEXMEM dest: %x", EX_MEM.destination);
-				EX_MEM.register_immediate = 1;
+			}
+			if (strcmp(buffer, "branch") == 0){
+				if (sscanf(args, "%d %d", &branch_in_id, &delay_slot) != 2){
+					break;
+				}
+				configure_branches(branch_in_id, delay_slot);
+				printf("Branches resolved in %s, delay slot %s\n", BRANCH_IN_ID ? "ID" : "EX", DELAY_SLOT ? "ON" : "OFF");
 				break;
-			case 0x0F: //LUI
-				EX_MEM.ALUOutput = (EX_MEM.B & 0x0000FFFF) | (EX_MEM.imm << 16);
-				EX_MEM.destination = EX_MEM.registerRt;
-				EX_MEM.register_immediate = 1;
+			}
+			if (sscanf(args, "%x", &start) != 1){
 				break;
-			case 0x20: //LB *******LOAD/STORE*********
-        //printf("\nLB");
-			case 0x21: //LH *******LOAD/STORE*********
-			case 0x23: //LW *******LOAD/STORE*********
-				EX_MEM.ALUOutput = EX_MEM.A + EX_MEM.imm;
-				//printf("\nEXMEM A: %x   EXMEM imm: %x   EXMEM ALUOUT: %x", EX_MEM.A, EX_MEM.imm, EX_MEM.ALUOutput);
-				EX_MEM.destination = EX_MEM.registerRt;
-				//printf("\nEX_MEM DEST : %x", EX_MEM.destination);
-				EX_MEM.memory_reference_load = 1;
+			}
+			add_breakpoint(start);
+			break;
+		case 'W':
+		case 'w':
+			if (strcmp(buffer, "waybench") == 0){
+				way_benchmark();
 				break;
-			case 0x28: //SB *******LOAD/STORE*********
-			case 0x29: //SH *******LOAD/STORE*********
-			case 0x2B: //SW *******LOAD/STORE*********
-        //printf("\nEX_Store Word!");
-				EX_MEM.ALUOutput = EX_MEM.A + EX_MEM.imm;
-				EX_MEM.destination = 0;
-				EX_MEM.memory_reference_store = 1;
+			}
+			if (sscanf(args, "%3s %x %x", watch_type, &start, &stop) != 3){
 				break;
-			case 0x4: //BEQ
-				if(EX_MEM.A == EX_MEM.B){
-					NEXT_STATE.PC = CURRENT_STATE.PC + (EX_MEM.imm << 2);
-					flush();
+			}
+			if (strcmp(buffer, "watchif") == 0){
+				if (sscanf(args, "%*s %*x %*x %x", &watch_value) != 1){
+					break;
 				}
+				add_watchpoint(parse_watch_type(watch_type), start, stop, TRUE, watch_value);
+			}else {
+				add_watchpoint(parse_watch_type(watch_type), start, stop, FALSE, 0);
+			}
+			break;
+		case 'D':
+		case 'd':
+			if (strcmp(buffer, "digest") == 0){
+				print_digest(sscanf(args, "%19s", buffer) == 1 && strcmp(buffer, "pages") == 0);
 				break;
-			case 0x5: //BNE
-				if(EX_MEM.A != EX_MEM.B){
-					NEXT_STATE.PC = CURRENT_STATE.PC + (EX_MEM.imm << 2);
-					flush();
+			}
+			if (strcmp(buffer, "dma") == 0){
+				if (sscanf(args, "%d %d", &dma_setup, &dma_word_cycles) != 2){
+					break;
 				}
+				configure_dma(dma_setup, dma_word_cycles);
+				printf("DMA: %u setup cycles, %u cycles per word\n", DMA_SETUP_CYCLES, DMA_WORD_CYCLES);
 				break;
-			case 0x6: //BLEZ
-				if((EX_MEM.A & 0x80000000) == 0x80000000 || EX_MEM.A == 0){
-					NEXT_STATE.PC = CURRENT_STATE.PC + (EX_MEM.imm << 2);
-					flush();
+			}
+			delete_debug_points();
+			break;
+		case 'T':
+		case 't':
+			if (strcmp(buffer, "tlb") == 0){
+				if (sscanf(args, " %c %d %d", &tlb_side, &tlb_entries, &tlb_ways) != 3 || (tlb_side != 'i' && tlb_side != 'd')){
+					break;
 				}
+				configure_tlb(tlb_side == 'i' ? ITLB : DTLB, tlb_entries, tlb_ways);
+			}
+			break;
+		case 'V':
+		case 'v':
+			if (sscanf(args, "%d %d", &victim_entries, &victim_latency) != 2){
 				break;
-			case 0x7: //BGTZ
-				if((EX_MEM.A & 0x80000000) != 0x80000000){
-					NEXT_STATE.PC = CURRENT_STATE.PC + (EX_MEM.imm << 2);
-					flush();
+			}
+			configure_victim(victim_entries, victim_latency);
+			break;
+		case 'F':
+		case 'f':
+			if (strcmp(buffer, "fill") == 0){
+				if (sscanf(args, "%d %d", &fill_mode, &fill_beat) != 2){
+					break;
 				}
-				break;
-			case 0x2:{ //J
-				uint32_t target = (EX_MEM.IR & 0x3FFFFFF) << 2;
-				uint32_t mask = CURRENT_STATE.PC & 0xF0000000;
-				NEXT_STATE.PC = target | mask;
-				flush();
+				configure_fill(fill_mode, fill_beat);
 				break;
 			}
-			case 0x3:{ //JAL
-				uint32_t target = (EX_MEM.IR & 0x3FFFFFF) << 2;
-				uint32_t mask = CURRENT_STATE.PC & 0xF0000000;
-				EX_MEM.ALUOutput = CURRENT_STATE.PC + 4; //address of next instruction
-				EX_MEM.destination = 31;
-				EX_MEM.register_register = 1;
-				NEXT_STATE.PC = EX_MEM.PC | target | 0x00;
-				flush();
+			if(sscanf(args, "%d", &ENABLE_FORWARDING) != 1){
 				break;
 			}
-			default:
-				// put more things here
-				printf("Instruction at 0x%x is not implemented!\n", CURRENT_STATE.PC);
-				break;
+			ENABLE_FORWARDING == 0 ? printf("Forwarding OFF\n") : printf("Forwarding ON\n");
+			break;
+	}
+	return MUMIPS_OK;
+}
+
+/***************************************************************/
+/* reset registers/memory and reload program                                                    */
+/***************************************************************/
+void reset() {   
+	int i;
+	
+	/*start from untouched (zero) memory, see init_memory()*/
+	for (i = 0; i < NUM_MEM_REGION; i++) {
+		free(MEM_REGIONS[i].mem);
+	}
+	init_memory();
+	
+	/*load program*/
+	write_program();
+	syscall_reset();
+	spm_reset();
+	profile_reset();
+	reuse_reset();
+	if (CLASSIFY_MISSES) {
+		classify_reset();
+	}
+	
+	/*reset every core*/
+	ooo_reset();
+	if (CORE_COUNT > 1){
+		core_step(CORE_RESET, 0);
+	}else {
+		reset_core();
+	}
+}
+
+/***************************************************************/
+/* reset this core's registers, pipeline, cache and stats                                           */
+/***************************************************************/
+void reset_core() {
+	int i;
+	/*reset registers*/
+	for (i = 0; i < MIPS_REGS; i++){
+		CURRENT_STATE.REGS[i] = 0;
+	}
+	CURRENT_STATE.HI = 0;
+	CURRENT_STATE.LO = 0;
+	if (CORE_COUNT > 1){
+		/*$k0 = core id, $k1 = number of cores*/
+		CURRENT_STATE.REGS[26] = CORE_ID;
+		CURRENT_STATE.REGS[27] = CORE_COUNT;
+	}
+	
+	/*empty the pipeline and the cache*/
+	memset(&IF_ID, 0, sizeof(IF_ID));
+	memset(&ID_EX, 0, sizeof(ID_EX));
+	memset(&EX_MEM, 0, sizeof(EX_MEM));
+	memset(&MEM_WB, 0, sizeof(MEM_WB));
+	memset(&IF_ID_2, 0, sizeof(IF_ID_2));
+	memset(&ID_EX_2, 0, sizeof(ID_EX_2));
+	memset(&EX_MEM_2, 0, sizeof(EX_MEM_2));
+	memset(&MEM_WB_2, 0, sizeof(MEM_WB_2));
+	memset(&L1Cache, 0, sizeof(L1Cache));
+	stalling = 0;
+	cacheStalling = 0;
+	delaySlotPending = FALSE;
+	branchBubble = FALSE;
+	tlb_reset();
+#ifdef HOST_PROFILE
+	host_profile_reset();
+#endif
+	
+	/*reset PC and stats*/
+	INSTRUCTION_COUNT = 0;
+	CYCLE_COUNT = 0;
+	cache_hits = 0;
+	cache_misses = 0;
+	victim_hits = 0;
+	memset(&blockFill, 0, sizeof(blockFill));
+	fill_early_restarts = 0;
+	fill_cycles_saved = 0;
+	fill_word_waits = 0;
+	fill_channel_waits = 0;
+	SKIPPED_CYCLES = 0;
+	BRANCH_COUNT = 0;
+	BRANCH_TAKEN = 0;
+	memset(&storeBuffer, 0, sizeof(storeBuffer));
+	store_buffer_stores = 0;
+	store_buffer_coalesced = 0;
+	store_buffer_full_stalls = 0;
+	store_buffer_forwards = 0;
+	store_buffer_occupancy = 0;
+	DUAL_ISSUE_CYCLES = 0;
+	SINGLE_ISSUE_CYCLES = 0;
+	PAIR_DEPENDENCIES = 0;
+	PAIR_MEM_CONFLICTS = 0;
+	PAIR_MULDIV_CONFLICTS = 0;
+	PAIR_CONTROL_BREAKS = 0;
+	prefetch_reset();
+	sample_reset();
+	CORES[CORE_ID].llValid = 0;
+	CORES[CORE_ID].busReads = 0;
+	CORES[CORE_ID].busReadExclusives = 0;
+	CORES[CORE_ID].busUpgrades = 0;
+	CORES[CORE_ID].invalidations = 0;
+	CORES[CORE_ID].interventions = 0;
+	CORES[CORE_ID].busWaits = 0;
+	CURRENT_STATE.PC =  MEM_TEXT_BEGIN;
+	NEXT_STATE = CURRENT_STATE;
+	RUN_FLAG = TRUE;
+}
+
+/***************************************************************/
+/* Allocate and set memory to zero                                                                            */
+/***************************************************************/
+void init_memory() {                                           
+	int i;
+	for (i = 0; i < NUM_MEM_REGION; i++) {
+		uint32_t region_size = MEM_REGIONS[i].end - MEM_REGIONS[i].begin + 1;
+		/*calloc leaves untouched pages unbacked, the regions add up to ~4GB*/
+		MEM_REGIONS[i].mem = calloc(region_size, 1);
+    if(MEM_REGIONS[i].mem == NULL){
+      printf("\nMemory malloc failed!");
+     }
+	}
+	digest_reset();
+}
+
+/**************************************************************/
+/* read the program file into the program image                                                    */
+/**************************************************************/
+int load_program() {                   
+	FILE * fp;
+	uint32_t word;
+	uint32_t capacity = 0;
+
+	/* Open program file. */
+	fp = fopen(prog_file, "r");
+	if (fp == NULL) {
+		printf("Error: Can't open program file %s\n", prog_file);
+		return -1;
+	}
+
+	/* Read in the program, reset() writes it into memory. */
+	PROGRAM_SIZE = 0;
+	while( fscanf(fp, "%x\n", &word) != EOF ) {
+		if (PROGRAM_SIZE == capacity) {
+			capacity = capacity ? 2 * capacity : 1024;
+			PROGRAM_IMAGE = realloc(PROGRAM_IMAGE, capacity * sizeof(uint32_t));
 		}
+		PROGRAM_IMAGE[PROGRAM_SIZE++] = word;
 	}
-	if(EX_MEM.register_immediate || EX_MEM.register_register || EX_MEM.memory_reference_load){
-		EX_MEM.RegWrite = 1;
+	fclose(fp);
+	return 0;
+}
+
+/************************************************************/
+/* Write the program image to the start of the text segment                                   */ 
+/************************************************************/
+void write_program() {
+	uint32_t i, address;
+
+	for (i = 0; i < PROGRAM_SIZE; i++) {
+		address = MEM_TEXT_BEGIN + (i * 4);
+		mem_write_32(address, PROGRAM_IMAGE[i]);
+		LOG(LOG_LOADER, LOG_DEBUG, "writing 0x%08x into address 0x%08x", PROGRAM_IMAGE[i], address);
 	}
+	LOG(LOG_LOADER, LOG_INFO, "%u words loaded at 0x%08x", PROGRAM_SIZE, MEM_TEXT_BEGIN);
 }
 
 /************************************************************/
-/* instruction decode (ID) pipeline stage:                                                         */ 
+/* maintain the pipeline                                                                                           */ 
 /************************************************************/
-void ID()
+void handle_pipeline()
 {
-	//Break IF_ID.IR into different parts ie. instruction and operands.
-	uint32_t rs, rt, immediate, rd, opcode, function;
+	/*INSTRUCTION_COUNT should be incremented when instruction is done*/
+	/*Since we do not have branch/jump instructions, INSTRUCTION_COUNT should be incremented in WB stage */
 	
-	opcode = (IF_ID.IR & 0xFC000000) >> 26;
-	function = (IF_ID.IR & 0x0000003F);
-	rs = (IF_ID.IR & 0x03E00000) >> 21;
-	rt = (IF_ID.IR & 0x001F0000) >> 16;
-	immediate = IF_ID.IR & 0x0000FFFF;
-	rd = (IF_ID.IR & 0xF800) >> 11;
+	HOST_PROF_BEGIN(HOST_WB);
+	WB();
+	HOST_PROF_END(HOST_WB);
+	HOST_PROF_BEGIN(HOST_MEM);
+	MEM();
+	HOST_PROF_END(HOST_MEM);
+	HOST_PROF_BEGIN(HOST_EX);
+	EX();
+	HOST_PROF_END(HOST_EX);
+	HOST_PROF_BEGIN(HOST_ID);
+	ID();
+	HOST_PROF_END(HOST_ID);
+	HOST_PROF_BEGIN(HOST_IF);
+	IF();
+	HOST_PROF_END(HOST_IF);
+}
+
+/************************************************************/
+/* writeback (WB) pipeline stage:                                                                          */ 
+/************************************************************/
+void WB()
+{
+  //if cache is stalling, skip
+  if(cacheStalling != 0){
+    return;
+  }
   
+	writeback(&MEM_WB);
+	retire(&MEM_WB);
+	if(ISSUE_WIDTH == 2){
+		writeback(&MEM_WB_2); //second slot is always the younger instruction
+		retire(&MEM_WB_2);
+	}
+}
+
+/************************************************************/
+/* commit a single MEM/WB latch to the register file                                          */ 
+/************************************************************/
+void writeback(CPU_Pipeline_Reg *reg)
+{
+	uint32_t rd, rt, rs;
+	rd = reg->IR & 0xF800;
+	rd >>= 11; 
+	rt = reg->IR & 0x1F0000;
+	rt >>= 16;
+	rs = reg->IR & 0x3E00000;
+	rs >>= 21;
 	
+	if(reg->memory_reference_load){
+		NEXT_STATE.REGS[reg->destination] = reg->LMD;
+		LOG(LOG_PIPELINE, LOG_TRACE, "0x%08x load writes $%u = 0x%08x", reg->PC, reg->destination, reg->LMD);
+	}
+	if(reg->memory_reference_store && reg->LLSC){
+		NEXT_STATE.REGS[reg->destination] = reg->LMD; //SC result
+	}
+	if(reg->register_register){
+		NEXT_STATE.REGS[reg->destination] = reg->ALUOutput;
+	}
+	if(reg->register_immediate){
+		NEXT_STATE.REGS[rt] = reg->ALUOutput;
+	}
+	if(reg->MFHI){
+		NEXT_STATE.REGS[reg->destination] = CURRENT_STATE.HI;
+	}
+	if(reg->MTHI){
+		NEXT_STATE.HI = CURRENT_STATE.REGS[rs];
+	}
+	if(reg->MFLO){
+		NEXT_STATE.REGS[reg->destination] = CURRENT_STATE.LO;
+	}
+	if(reg->MTLO){
+		NEXT_STATE.LO = CURRENT_STATE.REGS[rs];
+	}
+	if(reg->MULDIV){
+		NEXT_STATE.LO = reg->LO;
+		NEXT_STATE.HI = reg->HI;
+	}
+}
 
-	//printf("regWrite: %d, destination: %d, forwarding: %d\n", EX_MEM.RegWrite, EX_MEM.destination, ENABLE_FORWARDING);
-	if((EX_MEM.RegWrite && (EX_MEM.destination != 0) && (EX_MEM.destination == rs))){
-		//Is forwarding enabled?
-		if(ENABLE_FORWARDING){
-			//Forward the data and dont stall.
-			FORWARD_A = 10;
-			//printf("\nFowarding A from EX_MEM");
-		}else{
-			stalling = 1;
-		}
-	}else if((EX_MEM.RegWrite && (EX_MEM.destination != 0) && (EX_MEM.destination == rt))){
-		//Is forwarding enabled?
-		if(ENABLE_FORWARDING){
-			//Forward the data and dont stall.
-			FORWARD_B = 10;
-			//printf("\nFowarding B from EX_MEM");
-		}else{
-			stalling = 1;
-		}
-	}else if((MEM_WB.RegWrite && (MEM_WB.destination != 0) && (MEM_WB.destination == rs))){
-		if(ENABLE_FORWARDING){
-			//Forward the data from mem and dont stall.
-			FORWARD_A = 01;
-		}else{
-			stalling = 1;
-		}
-	}else if(MEM_WB.RegWrite && (MEM_WB.destination != 0) && (MEM_WB.destination == rt)){
-		if(ENABLE_FORWARDING){
-			//Forward the data from mem and dont stall.
-			FORWARD_B = 01;
+/************************************************************/
+/* count a committed instruction and stop on the exit SYSCALL                                */ 
+/************************************************************/
+void retire(CPU_Pipeline_Reg *reg)
+{
+	if(reg->valid && CHECKING){
+		check_commit(reg);
+	}
+	if(reg->SYSCALL){
+		RUN_FLAG = FALSE;
+		if(CHECKING){
+			check_flush();
+		}
+		//program is over, let the last stores reach memory
+		bus_lock();
+		store_buffer_drain(&storeBuffer, storeBuffer.count);
+		bus_unlock();
+	}
+	
+	if(reg->valid){ //bubbles do not count as instructions
+		INSTRUCTION_COUNT++;
+		BREAK_CHECK(reg->PC);
+		PROFILE_RETIRE(reg->PC);
+		if(reg->opClass == OP_BRANCH){
+			BRANCH_COUNT++;
+		}
+	}
+}
+
+/************************************************************/
+/* memory access (MEM) pipeline stage:                                                          */ 
+/************************************************************/
+void MEM()
+{
+  CPU_Pipeline_Reg *memOp;
+  
+  store_buffer_tick();
+  if(PREFETCH_MODE != PREFETCH_OFF){
+    prefetch_tick();
+  }
+  if(SPM_ON){
+    dma_tick();
+  }
+  if(cacheStalling==0){
+    //not stalling
+    MEM_WB = EX_MEM;
+	  latch_clear(&EX_MEM);
+    if(ISSUE_WIDTH == 2){
+      MEM_WB_2 = EX_MEM_2;
+      latch_clear(&EX_MEM_2);
+    }
+    //skip if no memory load/store
+    memOp = memory_slot();
+    if(memOp == NULL){
+      return;
+    }
+    
+    if(MMU_MODE != MMU_OFF && !tlb_lookup(DTLB, memOp->ALUOutput, TRUE)){
+      //translate first: walk the page table (or trap to the refill handler), then access
+      cacheStalling++;
+      missLatency = tlb_refill(DTLB, memOp->ALUOutput);
+      tlbWalking = TRUE;
+      if(MMU_MODE == MMU_SOFTWARE_REFILL){
+        tlb_trap();
+      }
+      return;
+    }
+    data_access(memOp);
+  } else {
+    //MISS//
+    PROFILE_STALL(memory_slot()->PC, 1);
+    if(cacheStalling >= missLatency){
+      //end of cache stalling
+      cacheStalling = 0;
+      stalling = 0;
+      if(tlbWalking){
+        tlbWalking = FALSE;
+        data_access(memory_slot()); //may start a cache miss of its own
+      } else {
+        cache_fill(memory_slot());
+      }
+    } else {
+      cacheStalling++;
+    }
+  }
+}
+
+/************************************************************/
+/* the translated access: scratchpad/DMA registers, or the L1 cache                         */ 
+/************************************************************/
+void data_access(CPU_Pipeline_Reg *reg)
+{
+  //scratchpad and DMA registers: no tag check, never miss
+  if(SPM_CONTAINS(reg->ALUOutput) || DMA_REGISTER(reg->ALUOutput)){
+    spm_access(reg);
+    return;
+  }
+  
+  //HIT MISS LOGIC//
+  //Look in cache at block[blockIndex]
+    //compare tags
+    //check valid bit
+      //hit/miss
+  HOST_PROF_BEGIN(HOST_CACHE);
+  cache_access(reg);
+  HOST_PROF_END(HOST_CACHE);
+}
+
+/************************************************************/
+/* latch holding the memory op of this cycle (at most one is issued per cycle)                 */ 
+/************************************************************/
+CPU_Pipeline_Reg *memory_slot()
+{
+  if(MEM_WB.memory_reference_load || MEM_WB.memory_reference_store){
+    return &MEM_WB;
+  }
+  if(ISSUE_WIDTH == 2 && (MEM_WB_2.memory_reference_load || MEM_WB_2.memory_reference_store)){
+    return &MEM_WB_2;
+  }
+  return NULL;
+}
+
+/************************************************************/
+/* look up the L1 cache for a load/store                                                       */ 
+/************************************************************/
+void cache_access(CPU_Pipeline_Reg *reg)
+{
+  int p, v;
+  CacheBlock victim;
+  uint32_t currentTag = CACHE_TAG(reg->ALUOutput);
+  uint32_t blockIndex = CACHE_INDEX(reg->ALUOutput);
+  uint32_t blockAddress = CACHE_BLOCK_ADDRESS(reg->ALUOutput);
+  
+  REUSE_ACCESS(reg->ALUOutput);
+  if(CLASSIFY_MISSES && CORE_ID == 0){
+    classify_access(reg->ALUOutput);
+  }
+  bus_lock();
+  //HIT//
+    //Load
+      //Give cpu value cache[blockIndex].words[wordOffset]
+    //Store
+      //Update the value at cache[blockIndex].words[wordOffset]
+      //Queue the word in the store buffer (wait if it is full)
+  if((L1Cache.blocks[blockIndex].tag == currentTag) && (L1Cache.blocks[blockIndex].valid == 1)){
+    LOG(LOG_CACHE, LOG_DEBUG, "0x%08x hit 0x%08x", reg->PC, reg->ALUOutput);
+    //cache hit, so load/store from cache
+    cache_hits++;
+    if(L1Cache.blocks[blockIndex].prefetched){
+      //first demand use of a prefetched block
+      L1Cache.blocks[blockIndex].prefetched = 0;
+      prefetch_useful++;
+      prefetch_train(reg->PC, reg->ALUOutput, TRUE);
+    } else {
+      prefetch_train(reg->PC, reg->ALUOutput, FALSE);
+    }
+    
+    if(fill_word_pending(reg->ALUOutput)){
+      //block is still streaming in and this word is not here yet, cache_fill() finishes the access
+      cacheStalling++;
+      missLatency = fill_word_arrival(reg->ALUOutput) - CYCLE_COUNT;
+      fill_word_waits++;
+    } else if(reg->memory_reference_load){
+      cache_load(reg);
+      LOG(LOG_CACHE, LOG_TRACE, "0x%08x load 0x%08x = 0x%08x", reg->PC, reg->ALUOutput, reg->LMD);
+    } else if(reg->memory_reference_store && store_buffer_blocked(blockAddress)){
+      //store buffer full, hold MEM until its oldest entry has drained
+      cacheStalling++;
+      missLatency = storeBuffer.drainDone > CYCLE_COUNT ? storeBuffer.drainDone - CYCLE_COUNT : 1;
+      store_buffer_full_stalls += missLatency;
+    } else if(reg->memory_reference_store){
+      cache_store(reg);
+      LOG(LOG_CACHE, LOG_TRACE, "0x%08x store 0x%08x = 0x%08x", reg->PC, reg->ALUOutput, reg->B);
+    }
+  } else {
+    LOG(LOG_CACHE, LOG_DEBUG, "0x%08x miss 0x%08x", reg->PC, reg->ALUOutput);
+    //cache miss, start stalling
+    cacheStalling++;
+    v = victim_lookup(blockAddress);
+    if(v >= 0){
+      //conflict miss, swap the block back in from the victim buffer
+      victim = L1Cache.blocks[blockIndex];
+      L1Cache.blocks[blockIndex] = L1Cache.victims[v].block;
+      L1Cache.victims[v].block = victim;
+      L1Cache.victimTags.tags[v] = CACHE_ADDRESS(victim.tag, blockIndex);
+      L1Cache.victimTags.valid[v] = victim.valid ? 0xFFFFFFFF : 0;
+      L1Cache.victims[v].lastUse = CYCLE_COUNT;
+      victim_hits++;
+      missLatency = VICTIM_HIT_PENALTY;
+      if(L1Cache.blocks[blockIndex].prefetched){
+        L1Cache.blocks[blockIndex].prefetched = 0;
+        prefetch_useful++;
+      }
+      bus_unlock();
+      return;
+    }
+    cache_misses++;
+    PROFILE_MISS(reg->PC);
+    if(CLASSIFY_MISSES && CORE_ID == 0){
+      classify_miss(reg->PC, reg->ALUOutput);
+    }
+    missLatency = CACHE_MISS_PENALTY;
+    if(pollutedTag[blockIndex] == currentTag + 1){
+      prefetch_polluting++;
+    }
+    p = prefetch_in_flight(blockAddress);
+    if(p >= 0){
+      //the prefetch is already on its way, only wait for the rest of it
+      prefetch_late++;
+      missLatency = prefetchQueue[p].readyCycle > CYCLE_COUNT ? prefetchQueue[p].readyCycle - CYCLE_COUNT : 1;
+      prefetchQueue[p].valid = 0;
+    } else if(FILL_MODE != FILL_WHOLE_BLOCK){
+      missLatency = fill_start(reg->ALUOutput);
+    }
+    prefetch_train(reg->PC, reg->ALUOutput, TRUE);
+  }
+  bus_unlock();
+}
+
+/************************************************************/
+/* refill the block once the miss penalty has elapsed                                          */ 
+/************************************************************/
+void cache_fill(CPU_Pipeline_Reg *reg)
+{
+  int i;
+  uint32_t currentTag = CACHE_TAG(reg->ALUOutput);
+  uint32_t blockIndex = CACHE_INDEX(reg->ALUOutput);
+  uint32_t blockAddress = CACHE_BLOCK_ADDRESS(reg->ALUOutput);
+  
+  //MISS//
+    //Read block from memory (four words starting at blockAddress)
+    //Set valid bit and tag, other caches see a read or a write miss on the bus
+    //Load: return value to cpu
+    //Store: update the word, then write the block through the write buffer
+  bus_lock();
+  if(L1Cache.blocks[blockIndex].valid && L1Cache.blocks[blockIndex].tag == currentTag){
+    //swapped back in from the victim buffer, or the wanted word of a block being filled arrived
+    if(reg->memory_reference_load){
+      cache_load(reg);
+    } else if(reg->memory_reference_store){
+      cache_store(reg);
+    }
+    bus_unlock();
+    return;
+  }
+  victim_insert(blockIndex);
+  if(reg->memory_reference_store){
+    snoop(BUS_READ_EXCLUSIVE, blockAddress);
+    CORES[CORE_ID].busReadExclusives++;
+    L1Cache.blocks[blockIndex].state = MESI_MODIFIED;
+  } else {
+    L1Cache.blocks[blockIndex].state = snoop(BUS_READ, blockAddress) ? MESI_SHARED : MESI_EXCLUSIVE;
+    CORES[CORE_ID].busReads++;
+  }
+  for(i = 0; i < WORD_PER_BLOCK; i++){
+    L1Cache.blocks[blockIndex].words[i] = mem_read_32(blockAddress + (i * 4));
+  }
+  store_buffer_forward(blockAddress, L1Cache.blocks[blockIndex].words);
+  if(L1Cache.blocks[blockIndex].valid && L1Cache.blocks[blockIndex].prefetched){
+    prefetch_useless++;
+  }
+  L1Cache.blocks[blockIndex].valid = 1; //block is now valid
+  L1Cache.blocks[blockIndex].prefetched = 0;
+  L1Cache.blocks[blockIndex].tag = currentTag;
+  pollutedTag[blockIndex] = 0;
+  
+  if(reg->memory_reference_load){
+    cache_load(reg); //return word to CPU
+    LOG(LOG_CACHE, LOG_TRACE, "0x%08x fill, load 0x%08x = 0x%08x", reg->PC, reg->ALUOutput, reg->LMD);
+  } else if(reg->memory_reference_store){
+    cache_store(reg);
+    LOG(LOG_CACHE, LOG_TRACE, "0x%08x fill, store 0x%08x = 0x%08x into block %u", reg->PC, reg->ALUOutput, reg->B, blockIndex);
+  }
+  bus_unlock();
+}
+
+/************************************************************/
+/* read the word from a resident block, LL also sets the link                                 */ 
+/************************************************************/
+void cache_load(CPU_Pipeline_Reg *reg)
+{
+  reg->LMD = L1Cache.blocks[CACHE_INDEX(reg->ALUOutput)].words[CACHE_WORD_OFFSET(reg->ALUOutput)];
+  WATCH_ACCESS(reg->PC, reg->ALUOutput, reg->LMD, WATCH_READ);
+  if(reg->LLSC){
+    CORES[CORE_ID].llValid = 1;
+    CORES[CORE_ID].llAddress = reg->ALUOutput;
+  }
+}
+
+/************************************************************/
+/* write the word into a resident block and through to memory. SC only writes if its  */
+/* link survived and leaves 1/0 in LMD.                                                               */ 
+/************************************************************/
+void cache_store(CPU_Pipeline_Reg *reg)
+{
+  CacheBlock *block = &L1Cache.blocks[CACHE_INDEX(reg->ALUOutput)];
+  uint32_t blockAddress = CACHE_BLOCK_ADDRESS(reg->ALUOutput);
+  
+  if(reg->LLSC){
+    reg->LMD = CORES[CORE_ID].llValid && CORES[CORE_ID].llAddress == reg->ALUOutput;
+    CORES[CORE_ID].llValid = 0;
+    if(!reg->LMD){
+      return;
+    }
+  }
+  if(CHECKING){
+    check_snapshot(reg->ALUOutput); //reference keeps the page as it was
+  }
+  //other copies have to go before this one can be written
+  if(block->state == MESI_SHARED){
+    snoop(BUS_UPGRADE, blockAddress);
+    CORES[CORE_ID].busUpgrades++;
+  }
+  block->state = MESI_MODIFIED;
+  block->words[CACHE_WORD_OFFSET(reg->ALUOutput)] = reg->B; //update cache
+  WATCH_ACCESS(reg->PC, reg->ALUOutput, reg->B, WATCH_WRITE);
+  
+  //queue the word for memory
+  store_buffer_insert(reg->ALUOutput, reg->B);
+}
+
+/************************************************************/
+/* block fill: a miss goes to memory now (or once the channel is free), returns the   */
+/* cycles until the wanted word is in                                                              */ 
+/************************************************************/
+uint32_t fill_start(uint32_t address)
+{
+  uint32_t start = CYCLE_COUNT, latency;
+  uint32_t stream = (WORD_PER_BLOCK - 1) * FILL_BEAT_CYCLES; //first word to last word
+  
+  if(blockFill.active && blockFill.firstArrival + stream > CYCLE_COUNT){
+    //memory is still sending the previous block
+    start = blockFill.firstArrival + stream;
+    fill_channel_waits += start - CYCLE_COUNT;
+  }
+  blockFill.active = 1;
+  blockFill.blockAddress = CACHE_BLOCK_ADDRESS(address);
+  blockFill.firstWord = FILL_MODE == FILL_CRITICAL_FIRST ? CACHE_WORD_OFFSET(address) : 0;
+  blockFill.firstArrival = start + CACHE_MISS_PENALTY - stream;
+  latency = fill_word_arrival(address) - CYCLE_COUNT;
+  if(latency < start + CACHE_MISS_PENALTY - CYCLE_COUNT){
+    fill_early_restarts++;
+    fill_cycles_saved += start + CACHE_MISS_PENALTY - CYCLE_COUNT - latency;
+  }
+  return latency;
+}
+
+/* cycle the word at this address arrives in the block being filled */
+uint32_t fill_word_arrival(uint32_t address)
+{
+  uint32_t position = (CACHE_WORD_OFFSET(address) + WORD_PER_BLOCK - blockFill.firstWord) % WORD_PER_BLOCK;
+  
+  return blockFill.firstArrival + position * FILL_BEAT_CYCLES;
+}
+
+/* is this word of a resident block still on its way from memory? */
+int fill_word_pending(uint32_t address)
+{
+  return FILL_MODE != FILL_WHOLE_BLOCK && blockFill.active && blockFill.blockAddress == CACHE_BLOCK_ADDRESS(address) &&
+    fill_word_arrival(address) > CYCLE_COUNT;
+}
+
+/************************************************************/
+/* victim buffer: entry holding this block, -1 if none (or no victim buffer)               */ 
+/************************************************************/
+int victim_lookup(uint32_t blockAddress)
+{
+  return victim_find(&L1Cache, blockAddress);
+}
+
+/* same, in any core's cache */
+int victim_find(Cache *cache, uint32_t blockAddress)
+{
+  return tag_match(cache->victimTags.tags, cache->victimTags.valid, VICTIM_ENTRIES, blockAddress);
+}
+
+/************************************************************/
+/* way lookup: first of the ways whose tag matches and whose valid mask is set, -1 if */
+/* none. AVX2 does 8 ways per compare, SSE2 4, the scalar loop picks up the rest.      */ 
+/************************************************************/
+int tag_match(const uint32_t *tags, const uint32_t *valid, int ways, uint32_t tag)
+{
+  int i = 0, mask;
+  
+#if defined(__AVX2__)
+  __m256i key8 = _mm256_set1_epi32((int)tag);
+  for(; i + 8 <= ways; i += 8){
+    __m256i hit8 = _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *)(tags + i)), key8),
+      _mm256_loadu_si256((const __m256i *)(valid + i)));
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit8));
+    if(mask){
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+#if defined(__SSE2__)
+  __m128i key4 = _mm_set1_epi32((int)tag);
+  for(; i + 4 <= ways; i += 4){
+    __m128i hit4 = _mm_and_si128(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(tags + i)), key4),
+      _mm_loadu_si128((const __m128i *)(valid + i)));
+    mask = _mm_movemask_ps(_mm_castsi128_ps(hit4));
+    if(mask){
+      return i + __builtin_ctz(mask);
+    }
+  }
+#endif
+  (void)mask;
+  for(; i < ways; i++){
+    if(valid[i] && tags[i] == tag){
+      return i;
+    }
+  }
+  return -1;
+}
+
+/* one way at a time, the baseline for waybench */
+int tag_match_scalar(const uint32_t *tags, const uint32_t *valid, int ways, uint32_t tag)
+{
+  int i;
+  
+  for(i = 0; i < ways; i++){
+    if(valid[i] && tags[i] == tag){
+      return i;
+    }
+  }
+  return -1;
+}
+
+/************************************************************/
+/* waybench: lookups per second of the scalar loop and tag_match() on a full tag   */
+/* store, by associativity. Half the keys hit (at a random way), half miss.          */ 
+/************************************************************/
+void way_benchmark()
+{
+  static TagStore store;
+  static uint32_t keys[4096];
+  int (*kernels[2])(const uint32_t *, const uint32_t *, int, uint32_t) = { tag_match_scalar, tag_match };
+  int ways, k, round, i;
+  uint32_t seed = 12345, rounds;
+  long sink = 0;
+  double seconds, rate[2];
+  struct timespec start, stop;
+  
+  printf("Way lookup kernel: %s\n", WAY_LOOKUP_KERNEL);
+  printf("[Ways]\t[Scalar Mlookups/s]\t[%s Mlookups/s]\t[Speedup]\n", WAY_LOOKUP_KERNEL);
+  for(ways = 4; ways <= MAX_WAYS; ways *= 2){
+    for(i = 0; i < ways; i++){
+      store.tags[i] = (uint32_t)i * 2654435761u; //distinct tags
+      store.valid[i] = 0xFFFFFFFF;
+    }
+    for(i = 0; i < 4096; i++){
+      seed = seed * 1103515245 + 12345;
+      keys[i] = (seed >> 16) & 1 ? store.tags[(seed >> 4) % ways] : store.tags[(seed >> 4) % ways] + 1;
+    }
+    rounds = (1 << 24) / (4096 * ways) + 1; //about the same work per associativity
+    for(k = 0; k < 2; k++){
+      clock_gettime(CLOCK_MONOTONIC, &start);
+      for(round = 0; round < (int)rounds; round++){
+        for(i = 0; i < 4096; i++){
+          sink += kernels[k](store.tags, store.valid, ways, keys[i]);
+        }
+      }
+      clock_gettime(CLOCK_MONOTONIC, &stop);
+      seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) / 1e9;
+      rate[k] = rounds * 4096.0 / seconds / 1e6;
+    }
+    printf("%d\t%.1f\t\t\t%.1f\t\t\t%.2fx\n", ways, rate[0], rate[1], rate[1] / rate[0]);
+  }
+  if(sink == 42){
+    printf("\n"); //keeps the lookups from being optimized away
+  }
+}
+
+/************************************************************/
+/* victim buffer: keep the block about to be replaced in this set, over the LRU entry */ 
+/************************************************************/
+void victim_insert(uint32_t blockIndex)
+{
+  int i, lru = 0;
+  
+  if(VICTIM_ENTRIES == 0 || !L1Cache.blocks[blockIndex].valid){
+    return;
+  }
+  for(i = 0; i < VICTIM_ENTRIES; i++){
+    if(!L1Cache.victimTags.valid[i]){
+      lru = i;
+      break;
+    }
+    if(L1Cache.victims[i].lastUse < L1Cache.victims[lru].lastUse){
+      lru = i;
+    }
+  }
+  L1Cache.victims[lru].block = L1Cache.blocks[blockIndex];
+  L1Cache.victimTags.tags[lru] = CACHE_ADDRESS(L1Cache.blocks[blockIndex].tag, blockIndex);
+  L1Cache.victimTags.valid[lru] = 0xFFFFFFFF;
+  L1Cache.victims[lru].lastUse = CYCLE_COUNT;
+}
+
+/************************************************************/
+/* prefetcher: learn from a demand access, trigger is set on a miss or on the first   */
+/* use of a prefetched block                                                                          */ 
+/************************************************************/
+void prefetch_train(uint32_t pc, uint32_t address, int trigger)
+{
+  int i;
+  Stride_Entry *entry;
+  int32_t stride;
+  
+  if(PREFETCH_MODE == PREFETCH_NEXT_LINE){
+    if(trigger){
+      for(i = 0; i < PREFETCH_DEGREE; i++){
+        prefetch_issue(CACHE_BLOCK_ADDRESS(address) + (PREFETCH_DISTANCE + i) * WORD_PER_BLOCK * 4);
+      }
+    }
+  } else if(PREFETCH_MODE == PREFETCH_STRIDE){
+    entry = &strideTable[(pc >> 2) % STRIDE_TABLE_SIZE];
+    if(entry->PC != pc){
+      //new load/store, start over
+      entry->PC = pc;
+      entry->lastAddress = address;
+      entry->stride = 0;
+      entry->confidence = 0;
+      return;
+    }
+    stride = (int32_t)(address - entry->lastAddress);
+    if(stride != 0 && stride == entry->stride){
+      if(entry->confidence < STRIDE_CONFIDENT){
+        entry->confidence++;
+      }
+    } else {
+      entry->stride = stride;
+      entry->confidence = 0;
+    }
+    entry->lastAddress = address;
+    if(entry->confidence >= STRIDE_CONFIDENT){
+      for(i = 0; i < PREFETCH_DEGREE; i++){
+        prefetch_issue(CACHE_BLOCK_ADDRESS(address + entry->stride * (PREFETCH_DISTANCE + i)));
+      }
+    }
+  }
+}
+
+/************************************************************/
+/* prefetcher: start fetching a block unless it is already here or on its way             */ 
+/************************************************************/
+void prefetch_issue(uint32_t blockAddress)
+{
+  int i, free = -1;
+  CacheBlock *block = &L1Cache.blocks[CACHE_INDEX(blockAddress)];
+  
+  if(block->valid && block->tag == CACHE_TAG(blockAddress)){
+    return;
+  }
+  if(victim_lookup(blockAddress) >= 0 || prefetch_in_flight(blockAddress) >= 0){
+    return;
+  }
+  for(i = 0; i < PREFETCH_QUEUE_SIZE; i++){
+    if(!prefetchQueue[i].valid){
+      free = i;
+      break;
+    }
+  }
+  if(free < 0){
+    return; //queue full, drop it
+  }
+  prefetchQueue[free].valid = 1;
+  prefetchQueue[free].blockAddress = blockAddress;
+  prefetchQueue[free].readyCycle = CYCLE_COUNT + CACHE_MISS_PENALTY;
+  prefetch_issued++;
+}
+
+/************************************************************/
+/* prefetcher: install the blocks that have arrived, called every cycle from MEM()   */ 
+/************************************************************/
+void prefetch_tick()
+{
+  int i, j;
+  uint32_t blockIndex;
+  CacheBlock *block;
+  
+  for(i = 0; i < PREFETCH_QUEUE_SIZE; i++){
+    if(!prefetchQueue[i].valid || prefetchQueue[i].readyCycle > CYCLE_COUNT){
+      continue;
+    }
+    prefetchQueue[i].valid = 0;
+    blockIndex = CACHE_INDEX(prefetchQueue[i].blockAddress);
+    block = &L1Cache.blocks[blockIndex];
+    //a demand miss in progress owns this set, its fill is about to replace the block anyway
+    if(cacheStalling && CACHE_INDEX(memory_slot()->ALUOutput) == blockIndex){
+      continue;
+    }
+    bus_lock();
+    if(block->valid){
+      if(block->prefetched){
+        prefetch_useless++;
+      } else {
+        pollutedTag[blockIndex] = block->tag + 1;
+      }
+    }
+    victim_insert(blockIndex);
+    block->state = snoop(BUS_READ, prefetchQueue[i].blockAddress) ? MESI_SHARED : MESI_EXCLUSIVE;
+    CORES[CORE_ID].busReads++;
+    for(j = 0; j < WORD_PER_BLOCK; j++){
+      block->words[j] = mem_read_32(prefetchQueue[i].blockAddress + (j * 4));
+    }
+    store_buffer_forward(prefetchQueue[i].blockAddress, block->words);
+    block->valid = 1;
+    block->prefetched = 1;
+    block->tag = CACHE_TAG(prefetchQueue[i].blockAddress);
+    bus_unlock();
+  }
+}
+
+/************************************************************/
+/* prefetcher: queue slot fetching this block, -1 if none                                        */ 
+/************************************************************/
+int prefetch_in_flight(uint32_t blockAddress)
+{
+  int i;
+  
+  for(i = 0; i < PREFETCH_QUEUE_SIZE; i++){
+    if(prefetchQueue[i].valid && prefetchQueue[i].blockAddress == blockAddress){
+      return i;
+    }
+  }
+  return -1;
+}
+
+/************************************************************/
+/* prefetcher: forget everything it learned and drop what is in flight                        */ 
+/************************************************************/
+void prefetch_reset()
+{
+  memset(prefetchQueue, 0, sizeof(prefetchQueue));
+  memset(strideTable, 0, sizeof(strideTable));
+  memset(pollutedTag, 0, sizeof(pollutedTag));
+  missLatency = CACHE_MISS_PENALTY;
+  prefetch_issued = 0;
+  prefetch_useful = 0;
+  prefetch_late = 0;
+  prefetch_useless = 0;
+  prefetch_polluting = 0;
+}
+
+/************************************************************/
+/* execution (EX) pipeline stage:                                                                          */ 
+/************************************************************/
+void EX()
+{
+	if(cacheStalling != 0){
+    return;
+  }
+  
+	EX_MEM = ID_EX;
+	latch_clear(&ID_EX);
+	if(ISSUE_WIDTH == 2){
+		EX_MEM_2 = ID_EX_2;
+		latch_clear(&ID_EX_2);
+	}
+	if(EX_MEM.valid){
+		execute(&EX_MEM);
+	}
+	if(ISSUE_WIDTH == 2 && EX_MEM_2.valid){
+		execute(&EX_MEM_2);
+	}
+}
+
+/************************************************************/
+/* ALU/branch work of the EX stage for a single latch                                          */ 
+/************************************************************/
+void execute(CPU_Pipeline_Reg *reg)
+{
+	uint64_t product, p1, p2;
+	reg->control = 0; //every flag
+
+	if(reg->opcode == 0x00 && reg->IR != 0x00){
+		switch(reg->function){
+				case 0x00:{ //SLL
+					uint32_t sa = reg->imm & 0x07C0;
+					sa = sa >> 6;
+					reg->ALUOutput = reg->B << sa;
+
+					reg->destination = reg->registerRd;
+					
+					reg->register_register = 1;
+					break;
+				}
+				case 0x02:{ //SRL
+					uint32_t sa = reg->imm & 0x07C0;
+					sa = sa >> 6;
+					reg->ALUOutput = reg->B >> sa;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				}
+				case 0x03:{ //SRA 
+					uint32_t sa = reg->imm & 0x07C0;
+					sa = sa >> 6;
+					if ((sa & 0x10) == 1)
+					{
+						reg->ALUOutput =  ~(~reg->B >> sa);
+					}
+					else{
+						reg->ALUOutput = reg->B >> sa;
+					}
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				}
+				case 0x0C:{ //SYSCALL
+					int halt;
+					//$v0 and $a0 are read in ID like any other operand
+					reg->ALUOutput = syscall_emulate(reg->A, reg->B, &halt);
+					reg->destination = 2; //results come back in $v0
+					reg->register_register = 1;
+					if(halt){
+						reg->SYSCALL = 1; //halt once the exit commits in WB
+						flush();
+					}
+					break;
+				}
+				case 0x10: //MFHI *******LOAD/STORE********* HI -> rd
+					reg->destination = reg->registerRd;
+					reg->MFHI = 1;
+					break;
+				case 0x11: //MTHI *******LOAD/STORE********* rs -> HI
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MTHI = 1;
+					break;
+				case 0x12: //MFLO *******LOAD/STORE********* LO -> rd
+					reg->destination = reg->registerRd;
+					reg->MFLO = 1;
+					break;
+				case 0x13: //MTLORegWrite *******LOAD/STORE********* rs -> LO
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MTLO = 1;
+					break;
+				case 0x18: //MULT
+					if ((reg->A & 0x80000000) == 0x80000000){
+						p1 = 0xFFFFFFFF00000000 | reg->A;
+					}else{
+						p1 = 0x00000000FFFFFFFF & reg->A;
+					}
+					if ((reg->B & 0x80000000) == 0x80000000){
+						p2 = 0xFFFFFFFF00000000 | reg->B;
+					}else{
+						p2 = 0x00000000FFFFFFFF & reg->B;
+					}
+					product = p1 * p2;
+					reg->LO = (product & 0X00000000FFFFFFFF);
+					reg->HI = (product & 0XFFFFFFFF00000000)>>32;
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MULDIV = 1;
+					break;
+				case 0x19: //MULTU
+					product = (uint64_t)reg->A * (uint64_t)reg->B;
+					reg->LO = (product & 0X00000000FFFFFFFF);
+					reg->HI = (product & 0XFFFFFFFF00000000)>>32;
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MULDIV = 1;
+					break;
+				case 0x1A: //DIV 
+					if(reg->B != 0)
+					{
+						reg->LO = (int32_t)reg->A / (int32_t)reg->B;
+						reg->HI = (int32_t)reg->A % (int32_t)reg->B;
+					}
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MULDIV = 1;
+					break;
+				case 0x1B: //DIVU
+					if(reg->B != 0)
+					{
+						reg->LO = (int32_t)reg->A / (int32_t)reg->B;
+						reg->HI = (int32_t)reg->A % (int32_t)reg->B;
+					}
+					reg->destination = 32; //32 represents LO/HI registers as destination
+					reg->MULDIV = 1;
+					break;
+				case 0x20: //ADD
+					reg->ALUOutput = reg->A + reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x21: //ADDU 
+					reg->ALUOutput = reg->A + reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x22: //SUB
+					reg->ALUOutput = reg->A - reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x23: //SUBU
+					reg->ALUOutput = reg->A - reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x24: //AND
+					reg->ALUOutput = reg->A & reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x25: //OR
+					reg->ALUOutput = reg->A | reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x26: //XOR
+					reg->ALUOutput = reg->A ^ reg->B;
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x27: //NOR
+					reg->ALUOutput = ~(reg->A | reg->B);
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x2A: //SLT
+					if((reg->A & 0x80000000) == 0x80000000 && (reg->B & 0x80000000) == 0x80000000){  //Negative comparison
+						if(reg->A < reg->B){
+							//set
+							reg->ALUOutput = 0x1;
+						}else{
+							//clear
+							reg->ALUOutput = 0x0;
+						}
+					}else if((reg->A & 0x80000000) == 0 && (reg->B & 0x80000000) == 0){    //Positive compare
+						if(reg->A < reg->B){
+							//set
+							reg->ALUOutput = 0x1;
+						}else{
+							//clear
+							reg->ALUOutput = 0x0;
+						}
+					}else if((reg->A & 0x80000000) == 0 && (reg->B & 0x80000000) == 0x80000000){ //A positive, imm negative
+						//clear
+						reg->ALUOutput = 0x0;
+					}else{ //A negative. imm positive
+						//set
+						reg->ALUOutput = 0x1;
+					}
+				
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					break;
+				case 0x9: //JALR
+					reg->ALUOutput = reg->PC + (DELAY_SLOT ? 8 : 4); //return past the delay slot, if there is one
+					reg->destination = reg->registerRd;
+					reg->register_register = 1;
+					redirect(reg, reg->A);
+					break;
+				case 0x8: //JR
+					redirect(reg, reg->A);
+					break;
+				default:
+					printf("Instruction at is not implemented!\n");
+					break;
+			}	
+	}else if(reg->opcode == 0x1 && reg->IR != 0x00){
+		//All special branches here... assuming the 'special' value for
+		//other instructions is never 0x1
+		
+		//New switch for special branches
+		switch(reg->registerRt){
+			case 0x1: //BGEZ
+				if((reg->A & 0x80000000) == 0){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			case 0x0: //BLTZ
+				if((reg->A & 0x80000000) == 0x80000000){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			default:
+					printf("\nCould not find the correct instruction! Special Branches");
+				break;
+		}
+	}else if(reg->IR != 0x00){
+		switch(reg->opcode){
+			case 0x08: //ADDI
+				reg->ALUOutput = reg->A + ( (reg->imm & 0x8000) > 0 ? (reg->imm | 0xFFFF0000) : (reg->imm & 0x0000FFFF));
+				reg->destination = reg->registerRt;
+				reg->register_immediate = 1;
+				break;
+			case 0x09: //ADDIU	instruction = IF_ID.IR ;
+				reg->ALUOutput = reg->A + ( (reg->imm & 0x8000) > 0 ? (reg->imm | 0xFFFF0000) : (reg->imm & 0x0000FFFF));
+				reg->destination = reg->registerRt;
+				//printf("\nEX MEM DEST : %x", reg->destination);
+				reg->register_immediate = 1;
+				//printf("\nreg->Destination after set: %d", reg->destination);
+				break;
+			case 0x0A: //SLTI
+				if((reg->A & 0x80000000) == 0x80000000 && (reg->imm & 0x80000000) == 0x80000000){  //Negative comparison
+					if(reg->A < reg->imm){
+						//set
+						reg->ALUOutput = 0x1;
+					}else{
+						//clear
+						reg->ALUOutput = 0x0;
+					}
+				}else if((reg->A & 0x80000000) == 0 && (reg->imm & 0x80000000) == 0){    //Positive compare
+					if(reg->A < reg->imm){
+						//set
+						reg->ALUOutput = 0x1;
+					}else{
+						//clear
+						reg->ALUOutput = 0x0;
+					}
+				}else if((reg->A & 0x80000000) == 0 && (reg->imm & 0x80000000) == 0x80000000){ //A positive, imm negative
+					//clear
+					reg->ALUOutput = 0x0;
+				}else{ //A negative. imm positive
+					//set
+					reg->ALUOutput = 0x1;
+				}
+				
+				reg->destination = reg->registerRt;
+				reg->register_immediate = 1;
+				break;
+			case 0x0C: //ANDI
+				reg->ALUOutput = reg->A & (reg->imm & 0x0000FFFF);
+				reg->destination = reg->registerRt;
+				reg->register_immediate = 1;
+				break;
+			case 0x0D: //ORI
+				reg->ALUOutput = reg->A | (reg->imm & 0x0000FFFF);
+				reg->destination = reg->registerRt;
+				reg->register_immediate = 1;
+				break;
+			case 0x0E: //XORI
+				//printf("\nXORI");
+				//printf("\nEXMEM A : %x\n", reg->A);
+				reg->ALUOutput = reg->A ^ (reg->imm & 0x0000FFFF);
+				//printf("\nEXMEM ALU: %x", reg->ALUOutput);
+				reg->destination = reg->registerRt;
+				//printf("\nEXMEM dest: %x", reg->destination);
+				reg->register_immediate = 1;
+				break;
+			case 0x0F: //LUI
+				reg->ALUOutput = (reg->B & 0x0000FFFF) | (reg->imm << 16);
+				reg->destination = reg->registerRt;
+				reg->register_immediate = 1;
+				break;
+			case 0x20: //LB *******LOAD/STORE*********
+        //printf("\nLB");
+			case 0x21: //LH *******LOAD/STORE*********
+			case 0x23: //LW *******LOAD/STORE*********
+				reg->ALUOutput = reg->A + reg->imm;
+				//printf("\nEXMEM A: %x   EXMEM imm: %x   EXMEM ALUOUT: %x", reg->A, reg->imm, reg->ALUOutput);
+				reg->destination = reg->registerRt;
+				//printf("\nEX_MEM DEST : %x", reg->destination);
+				reg->memory_reference_load = 1;
+				break;
+			case 0x30: //LL *******LOAD/STORE*********
+				reg->ALUOutput = reg->A + reg->imm;
+				reg->destination = reg->registerRt;
+				reg->memory_reference_load = 1;
+				reg->LLSC = 1;
+				break;
+			case 0x38: //SC *******LOAD/STORE*********
+				reg->ALUOutput = reg->A + reg->imm;
+				reg->destination = reg->registerRt; //gets 1 on success, 0 on failure
+				reg->memory_reference_store = 1;
+				reg->LLSC = 1;
+				break;
+			case 0x28: //SB *******LOAD/STORE*********
+			case 0x29: //SH *******LOAD/STORE*********
+			case 0x2B: //SW *******LOAD/STORE*********
+        //printf("\nEX_Store Word!");
+				reg->ALUOutput = reg->A + reg->imm;
+				reg->destination = 0;
+				reg->memory_reference_store = 1;
+				break;
+			case 0x4: //BEQ
+				if(reg->A == reg->B){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			case 0x5: //BNE
+				if(reg->A != reg->B){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			case 0x6: //BLEZ
+				if((reg->A & 0x80000000) == 0x80000000 || reg->A == 0){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			case 0x7: //BGTZ
+				if((reg->A & 0x80000000) != 0x80000000){
+					redirect(reg, reg->PC + 4 + (reg->imm << 2));
+				}
+				break;
+			case 0x2:{ //J
+				uint32_t target = (reg->IR & 0x3FFFFFF) << 2;
+				uint32_t mask = reg->PC & 0xF0000000;
+				redirect(reg, target | mask);
+				break;
+			}
+			case 0x3:{ //JAL
+				uint32_t target = (reg->IR & 0x3FFFFFF) << 2;
+				uint32_t mask = reg->PC & 0xF0000000;
+				reg->ALUOutput = reg->PC + (DELAY_SLOT ? 8 : 4); //return past the delay slot, if there is one
+				reg->destination = 31;
+				reg->register_register = 1;
+				redirect(reg, target | mask);
+				break;
+			}
+			default:
+				// put more things here
+				printf("Instruction at 0x%x is not implemented!\n", reg->PC);
+				break;
+		}
+	}
+	if(reg->register_immediate || reg->register_register || reg->memory_reference_load || reg->LLSC){
+		reg->RegWrite = 1;
+	}
+}
+
+/************************************************************/
+/* A taken branch/jump in execute(): send fetch to target (after the delay slot, if the  */
+/* delay slot is on)                                                                                        */ 
+/************************************************************/
+void redirect(CPU_Pipeline_Reg *reg, uint32_t target)
+{
+	if(reg->resolved){
+		return; //ID already did it
+	}
+	BRANCH_TAKEN++;
+	LOG(LOG_PIPELINE, LOG_DEBUG, "0x%08x redirects fetch to 0x%08x", reg->PC, target);
+	if(resolvingInID){
+		branchTaken = TRUE;
+		branchTarget = target;
+		return;
+	}
+	if(!DELAY_SLOT){
+		NEXT_STATE.PC = target;
+		flush();
+	}else if(NEXT_STATE.PC == reg->PC + 4){
+		//delay slot not fetched yet, fetch() turns around right after it
+		delaySlotPending = TRUE;
+		delaySlotTarget = target;
+	}else{
+		//delay slot is already behind us, only the fetch after it went the wrong way
+		NEXT_STATE.PC = target;
+		branchBubble = TRUE;
+	}
+}
+
+/* continue at the branch target once its delay slot has been fetched */
+void take_delayed_branch()
+{
+	if(delaySlotPending){
+		NEXT_STATE.PC = delaySlotTarget;
+		delaySlotPending = FALSE;
+	}
+}
+
+/************************************************************/
+/* Branch resolution in ID: run the branch through execute() on a copy to get the       */
+/* comparator's answer, redirect fetch now and let EX leave the PC alone                 */ 
+/************************************************************/
+void resolve_in_ID(CPU_Pipeline_Reg *reg)
+{
+	CPU_Pipeline_Reg probe = *reg;
+	
+	resolvingInID = TRUE;
+	branchTaken = FALSE;
+	execute(&probe);
+	resolvingInID = FALSE;
+	reg->resolved = 1;
+	if(!branchTaken){
+		return;
+	}
+	if(DELAY_SLOT){
+		delaySlotPending = TRUE; //IF fetches the delay slot this cycle
+		delaySlotTarget = branchTarget;
+	}else{
+		NEXT_STATE.PC = branchTarget;
+		branchBubble = TRUE; //IF would fetch the fall-through this cycle
+	}
+}
+
+/************************************************************/
+/* A branch compared in ID cannot use a result EX produced this cycle, or a load's data  */
+/* before it leaves MEM; older ALU results reach the comparator from EX/MEM.             */ 
+/************************************************************/
+int branch_operand_pending(uint32_t instruction, uint32_t reg)
+{
+	CPU_Pipeline_Reg *p;
+	int i;
+	
+	if(!instruction_reads(instruction, reg)){
+		return FALSE;
+	}
+	for(i = 0; i < ISSUE_WIDTH; i++){
+		p = i ? &EX_MEM_2 : &EX_MEM;
+		if((p->RegWrite || p->MFHI || p->MFLO) && p->destination == reg){
+			return TRUE;
+		}
+		p = i ? &MEM_WB_2 : &MEM_WB;
+		if((p->memory_reference_load || p->LLSC) && p->destination == reg){
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/************************************************************/
+/* instruction decode (ID) pipeline stage:                                                         */ 
+/************************************************************/
+void ID()
+{
+	int paired;
+	
+	stalling = 0;
+	//Wait while the cache is stalling or a branch/jump/exit in EX is redirecting fetch
+	if(cacheStalling != 0 || control_in_EX()){
+		stalling = 1;
+		if(cacheStalling == 0){
+			PROFILE_STALL(redirects_in_EX(&EX_MEM) ? EX_MEM.PC : EX_MEM_2.PC, 1); //charged to the branch/jump redirecting fetch
+		}
+		return;
+	}
+	
+	if(!IF_ID.valid){
+		return; //nothing fetched, ID_EX stays a bubble
+	}
+	if(!decode(&IF_ID, &ID_EX)){
+		stalling = 1;
+		PROFILE_STALL(IF_ID.PC, 1); //waiting for an operand
+		return;
+	}
+	if(BRANCH_IN_ID && ID_EX.opClass == OP_BRANCH){
+		resolve_in_ID(&ID_EX);
+	}
+	
+	if(ISSUE_WIDTH == 2 && IF_ID_2.valid){
+		paired = can_pair(ID_EX.IR, IF_ID_2.IR) && decode(&IF_ID_2, &ID_EX_2);
+		if(paired){
+			DUAL_ISSUE_CYCLES++;
+		}else{
+			//Second instruction becomes the oldest one in IF_ID next cycle
+			IF_ID = IF_ID_2;
+			latch_clear(&IF_ID_2);
+			SINGLE_ISSUE_CYCLES++;
+		}
+	}
+}
+
+/************************************************************/
+/* Decode one IF/ID latch into an ID/EX latch. Returns FALSE (the IF/ID latch untouched, */
+/* the ID/EX latch still a bubble) when an operand is not available yet.                      */ 
+/************************************************************/
+int decode(CPU_Pipeline_Reg *from, CPU_Pipeline_Reg *to)
+{
+	*to = *from; //EX already emptied it this cycle
+	decode_fields(to);
+	if(read_operand(to->registerRs, &to->A) || read_operand(to->registerRt, &to->B) ||
+		(BRANCH_IN_ID && to->opClass == OP_BRANCH &&
+		(branch_operand_pending(to->IR, to->registerRs) || branch_operand_pending(to->IR, to->registerRt)))){
+		latch_clear(to);
+		return FALSE;
+	}
+	
+	latch_clear(from);
+	return TRUE;
+}
+
+/************************************************************/
+/* Break IR into different parts ie. instruction and operands.                                 */ 
+/************************************************************/
+void decode_fields(CPU_Pipeline_Reg *reg)
+{
+	uint32_t immediate;
+	
+	reg->opcode = (reg->IR & 0xFC000000) >> 26;
+	reg->function = (reg->IR & 0x0000003F);
+	reg->registerRs = (reg->IR & 0x03E00000) >> 21;
+	reg->registerRt = (reg->IR & 0x001F0000) >> 16;
+	reg->registerRd = (reg->IR & 0xF800) >> 11;
+	reg->opClass = op_class(reg->IR);
+	immediate = reg->IR & 0x0000FFFF;
+	
+	if(reg->opcode == 0x00 && reg->function == 0x0C){
+		reg->registerRs = 2; //SYSCALL reads $v0 and $a0
+		reg->registerRt = 4;
+	}
+	
+	//Sign extension for immediate value
+	if(reg->IR & 0x00008000){
+		//Negative
+		uint32_t negative = 0xFFFF0000;
+		reg->imm = immediate | negative;
+	}else{
+		//Positive
+		reg->imm = immediate;
+	}
+}
+
+/************************************************************/
+/* Read a source register for ID. Returns TRUE if ID has to stall on it, otherwise     */
+/* *value holds the register file or forwarded value.                                           */ 
+/************************************************************/
+int read_operand(uint32_t reg, uint32_t *value)
+{
+	//Producers from youngest to oldest, the second slot is younger within a stage
+	CPU_Pipeline_Reg *producers[4] = { &EX_MEM_2, &EX_MEM, &MEM_WB_2, &MEM_WB };
+	CPU_Pipeline_Reg *p;
+	int i;
+	
+	*value = NEXT_STATE.REGS[reg];
+	if(reg == 0){
+		return FALSE;
+	}
+	for(i = 0; i < 4; i++){
+		p = producers[i];
+		if(!(p->RegWrite || p->MFHI || p->MFLO) || p->destination != reg){
+			continue;
+		}
+		//Is forwarding enabled? HI/LO moves only have their value at WB.
+		if(!ENABLE_FORWARDING || p->MFHI || p->MFLO){
+			return TRUE;
+		}
+		if(p->memory_reference_load || p->LLSC){
+			if(p == &EX_MEM || p == &EX_MEM_2){
+				return TRUE; //load-use (or SC result), data comes out of MEM next cycle
+			}
+			*value = p->LMD; //From MEM stage
+		}else{
+			*value = p->ALUOutput; //From EX stage
+		}
+		return FALSE;
+	}
+	return FALSE;
+}
+
+/************************************************************/
+/* TRUE while a branch, jump or exit SYSCALL sits in EX_MEM (fetch is redirected there)  */ 
+/************************************************************/
+int control_in_EX()
+{
+	return redirects_in_EX(&EX_MEM) || (ISSUE_WIDTH == 2 && redirects_in_EX(&EX_MEM_2));
+}
+
+/* ID-resolved branches are done, and with a delay slot the instruction behind a branch is on the right path */
+int redirects_in_EX(CPU_Pipeline_Reg *reg)
+{
+	if(reg->opClass == OP_SYSCALL){
+		return TRUE;
+	}
+	return reg->opClass == OP_BRANCH && !reg->resolved && !DELAY_SLOT;
+}
+
+/************************************************************/
+/* Instruction class helpers used by the hazard and issue logic                             */ 
+/************************************************************/
+int is_control(uint32_t instruction)
+{
+	uint32_t opcode = (instruction & 0xFC000000) >> 26;
+	uint32_t function = instruction & 0x0000003F;
+	
+	if(instruction == 0){
+		return FALSE;
+	}
+	if(opcode == 0x00){
+		return function == 0x08 || function == 0x09 || function == 0x0C; //JR, JALR, SYSCALL
+	}
+	return opcode >= 0x01 && opcode <= 0x07;
+}
+
+/* branches and jumps, i.e. control transfers other than SYSCALL */
+int is_branch(uint32_t instruction)
+{
+	return is_control(instruction) && !(((instruction & 0xFC000000) >> 26) == 0x00 && (instruction & 0x3F) == 0x0C);
+}
+
+/************************************************************/
+/* one-byte class of an instruction, so later stages test a byte instead of decoding  */ 
+/************************************************************/
+uint8_t op_class(uint32_t instruction)
+{
+	uint32_t opcode = (instruction & 0xFC000000) >> 26;
+	uint32_t function = instruction & 0x0000003F;
+	
+	if(instruction == 0){
+		return OP_NONE;
+	}
+	if(is_control(instruction)){
+		return is_branch(instruction) ? OP_BRANCH : OP_SYSCALL;
+	}
+	if(is_memory_op(instruction)){
+		return (opcode & 0x08) ? OP_STORE : OP_LOAD;
+	}
+	if(opcode == 0x00 && function >= 0x10 && function <= 0x1B){
+		return OP_MULDIV; //MFHI..DIVU
+	}
+	return OP_ALU;
+}
+
+/************************************************************/
+/* empty a latch: clear the valid bit and the flags the hazard checks read from any    */
+/* latch; the rest is rewritten by fetch() before the latch holds an instruction again  */ 
+/************************************************************/
+void latch_clear(CPU_Pipeline_Reg *reg)
+{
+	reg->valid = 0;
+	reg->opClass = OP_NONE;
+	reg->control = 0;
+}
+
+int is_memory_op(uint32_t instruction)
+{
+	switch((instruction & 0xFC000000) >> 26){
+		case 0x20: //LB
+		case 0x21: //LH
+		case 0x23: //LW
+		case 0x28: //SB
+		case 0x29: //SH
+		case 0x2B: //SW
+		case 0x30: //LL
+		case 0x38: //SC
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+int is_muldiv(uint32_t instruction)
+{
+	uint32_t function = instruction & 0x0000003F;
+	
+	if(instruction == 0 || ((instruction & 0xFC000000) >> 26) != 0x00){
+		return FALSE;
+	}
+	return (function >= 0x10 && function <= 0x13) || (function >= 0x18 && function <= 0x1B);
+}
+
+/* register written by the instruction, 0 if none (HI/LO are handled by is_muldiv) */
+uint32_t instruction_dest(uint32_t instruction)
+{
+	uint32_t opcode = (instruction & 0xFC000000) >> 26;
+	uint32_t function = instruction & 0x0000003F;
+	
+	if(instruction == 0){
+		return 0;
+	}
+	if(opcode == 0x00){
+		switch(function){
+			case 0x08: //JR
+			case 0x11: //MTHI
+			case 0x13: //MTLO
+			case 0x18: //MULT
+			case 0x19: //MULTU
+			case 0x1A: //DIV
+			case 0x1B: //DIVU
+				return 0;
+			case 0x0C: //SYSCALL, result in $v0
+				return 2;
+			default:
+				return (instruction & 0xF800) >> 11;
+		}
+	}
+	if(opcode == 0x03){ //JAL
+		return 31;
+	}
+	if((opcode >= 0x08 && opcode <= 0x0F) || opcode == 0x20 || opcode == 0x21 || opcode == 0x23 || opcode == 0x30 || opcode == 0x38){
+		return (instruction & 0x001F0000) >> 16;
+	}
+	return 0;
+}
+
+/* TRUE if the instruction reads register reg */
+int instruction_reads(uint32_t instruction, uint32_t reg)
+{
+	uint32_t opcode = (instruction & 0xFC000000) >> 26;
+	uint32_t rs = (instruction & 0x03E00000) >> 21;
+	uint32_t rt = (instruction & 0x001F0000) >> 16;
+	
+	if(reg == 0 || instruction == 0){
+		return FALSE;
+	}
+	if(opcode == 0x00 && (instruction & 0x0000003F) == 0x0C){
+		return reg == 2 || reg == 4; //SYSCALL
+	}
+	if(rs == reg && opcode != 0x02 && opcode != 0x03){
+		return TRUE;
+	}
+	//rt is a source for R-type, stores and BEQ/BNE
+	return rt == reg && (opcode == 0x00 || opcode == 0x04 || opcode == 0x05 || opcode == 0x28 || opcode == 0x29 || opcode == 0x2B || opcode == 0x38);
+}
+
+/************************************************************/
+/* Dual-issue rules: can second issue in the same cycle as first?                             */ 
+/************************************************************/
+int can_pair(uint32_t first, uint32_t second)
+{
+	uint32_t dest = instruction_dest(first);
+	
+	//Control transfers end an issue group, SYSCALL always issues alone
+	if(is_control(first) || (((second & 0xFC000000) >> 26) == 0x00 && (second & 0x3F) == 0x0C && second != 0)){
+		PAIR_CONTROL_BREAKS++;
+		return FALSE;
+	}
+	//One memory port
+	if(is_memory_op(first) && is_memory_op(second)){
+		PAIR_MEM_CONFLICTS++;
+		return FALSE;
+	}
+	//One MULT/DIV unit, which also owns HI/LO
+	if(is_muldiv(first) && is_muldiv(second)){
+		PAIR_MULDIV_CONFLICTS++;
+		return FALSE;
+	}
+	//No dependent pairs
+	if(dest != 0 && instruction_reads(second, dest)){
+		PAIR_DEPENDENCIES++;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/************************************************************/
+/* instruction fetch (IF) pipeline stage:                                                              */ 
+/************************************************************/
+void IF()
+{
+	if(!stalling && !sampleDraining && !branchBubble && itlb_ready()){
+		//Only refill the slots ID consumed
+		if(!IF_ID.valid){
+			fetch(&IF_ID);
+		}
+		if(ISSUE_WIDTH == 2 && !IF_ID_2.valid){
+			fetch(&IF_ID_2);
+		}
+	}
+	branchBubble = FALSE;
+
+}
+
+void fetch(CPU_Pipeline_Reg *reg)
+{
+	reg->IR = mem_read_32(NEXT_STATE.PC);
+	reg->PC = NEXT_STATE.PC;
+	reg->valid = 1;
+	reg->resolved = 0;
+	NEXT_STATE.PC += 4;
+	take_delayed_branch();
+}
+
+
+/************************************************************/
+/* out-of-order core model: one cycle                                                            */ 
+/************************************************************/
+void handle_ooo()
+{
+	int i, outstanding = 0;
+	
+	ooo_commit();
+	ooo_fill();
+	ooo_issue();
+	if(RUN_FLAG){
+		ooo_dispatch();
+	}
+	
+	OOO_ROB_OCCUPANCY += robCount;
+	for(i = 0; i < OOO_MSHRS; i++){
+		outstanding += MSHRS[i].valid;
+	}
+	if(outstanding != 0){
+		OOO_MISSES_OUTSTANDING += outstanding;
+		OOO_MISS_CYCLES++;
+	}
+}
+
+/************************************************************/
+/* TRUE once the ROB entry's result can be used                                                   */ 
+/************************************************************/
+int ooo_done(ROB_Entry *e)
+{
+	return e->issued && e->readyCycle <= CYCLE_COUNT;
+}
+
+int ooo_source_ready(ROB_Entry *e, int source)
+{
+	ROB_Entry *producer;
+	
+	if(e->srcIndex[source] < 0){
+		return TRUE;
+	}
+	producer = &ROB[e->srcIndex[source]];
+	//slot was reused, so the producer already committed
+	return producer->seq != e->srcSeq[source] || ooo_done(producer);
+}
+
+/************************************************************/
+/* retire completed instructions in program order                                                */ 
+/************************************************************/
+void ooo_commit()
+{
+	int i, n;
+	ROB_Entry *e;
+	
+	for(n = 0; n < OOO_WIDTH && robCount != 0; n++){
+		e = &ROB[robHead];
+		if(!ooo_done(e)){
+			break;
+		}
+		for(i = 0; i < e->numDests; i++){
+			if(ratIndex[e->destReg[i]] == robHead && ratSeq[e->destReg[i]] == e->seq){
+				ratIndex[e->destReg[i]] = -1; //value is architectural now
+			}
+		}
+		if(e->load || e->store){
+			lsqUsed--;
+		}
+		INSTRUCTION_COUNT++;
+		BREAK_CHECK(e->PC);
+		PROFILE_RETIRE(e->PC);
+		if(is_branch(e->IR)){
+			BRANCH_COUNT++;
+		}
+		robHead = (robHead + 1) % OOO_ROB_SIZE;
+		robCount--;
+		if(e->exitSyscall){
+			RUN_FLAG = FALSE;
+			break;
+		}
+	}
+}
+
+/************************************************************/
+/* install blocks whose miss penalty has elapsed                                                  */ 
+/************************************************************/
+void ooo_fill()
+{
+	int i, j;
+	uint32_t blockIndex;
+	
+	for(i = 0; i < OOO_MSHRS; i++){
+		if(MSHRS[i].valid && MSHRS[i].fillCycle <= CYCLE_COUNT){
+			blockIndex = CACHE_INDEX(MSHRS[i].blockAddress);
+			for(j = 0; j < WORD_PER_BLOCK; j++){
+				L1Cache.blocks[blockIndex].words[j] = mem_read_32(MSHRS[i].blockAddress + (j * 4));
+			}
+			L1Cache.blocks[blockIndex].valid = 1;
+			L1Cache.blocks[blockIndex].state = MESI_EXCLUSIVE;
+			L1Cache.blocks[blockIndex].tag = CACHE_TAG(MSHRS[i].blockAddress);
+			MSHRS[i].valid = 0;
+		}
+	}
+}
+
+/************************************************************/
+/* memory port access for a load/store, FALSE if no MSHR is free for the miss           */ 
+/************************************************************/
+int ooo_cache_access(ROB_Entry *e)
+{
+	int i, freeMSHR = -1;
+	uint32_t blockAddress = CACHE_BLOCK_ADDRESS(e->address);
+	uint32_t blockIndex = CACHE_INDEX(e->address);
+	
+	for(i = 0; i < OOO_MSHRS; i++){
+		if(MSHRS[i].valid && MSHRS[i].blockAddress == blockAddress){
+			OOO_MSHR_MERGES++;
+			e->readyCycle = MSHRS[i].fillCycle;
+			return TRUE;
+		}
+		if(!MSHRS[i].valid && freeMSHR < 0){
+			freeMSHR = i;
+		}
+	}
+	if(L1Cache.blocks[blockIndex].valid && L1Cache.blocks[blockIndex].tag == CACHE_TAG(e->address)){
+		cache_hits++;
+		e->readyCycle = CYCLE_COUNT + OOO_LATENCY[FU_LS];
+		return TRUE;
+	}
+	if(freeMSHR < 0){
+		OOO_MSHR_FULL_STALLS++;
+		return FALSE;
+	}
+	cache_misses++;
+	PROFILE_MISS(e->PC);
+	MSHRS[freeMSHR].valid = 1;
+	MSHRS[freeMSHR].blockAddress = blockAddress;
+	MSHRS[freeMSHR].fillCycle = CYCLE_COUNT + CACHE_MISS_PENALTY;
+	e->readyCycle = MSHRS[freeMSHR].fillCycle;
+	return TRUE;
+}
+
+/************************************************************/
+/* wakeup/select: oldest ready entries of each reservation station go to their unit    */ 
+/************************************************************/
+void ooo_issue()
+{
+	int i, k, idx, ready;
+	int budget[NUM_FU_CLASSES];
+	ROB_Entry *e;
+	
+	for(k = 0; k < NUM_FU_CLASSES; k++){
+		budget[k] = OOO_UNITS[k];
+	}
+	for(i = 0; i < robCount; i++){
+		idx = (robHead + i) % OOO_ROB_SIZE;
+		e = &ROB[idx];
+		if(e->issued || budget[e->fu] == 0){
+			continue;
+		}
+		ready = TRUE;
+		for(k = 0; k < e->numSources; k++){
+			ready = ready && ooo_source_ready(e, k);
+		}
+		if(!ready){
+			continue;
+		}
+		if(e->forwarded){
+			e->readyCycle = CYCLE_COUNT + OOO_LATENCY[FU_LS]; //store to load forwarding, no cache access
+		}else if(e->load || e->store){
+			if(!ooo_cache_access(e)){
+				continue;
+			}
 		}else{
-			stalling = 1;
+			e->readyCycle = CYCLE_COUNT + OOO_LATENCY[e->fu];
+		}
+		e->issued = 1;
+		rsUsed[e->fu]--;
+		budget[e->fu]--;
+	}
+}
+
+/************************************************************/
+/* fetch, execute functionally, rename and place into the ROB/RS/LSQ                       */ 
+/************************************************************/
+void ooo_dispatch()
+{
+	int n, i, idx, fu, sources[3], numSources;
+	uint32_t IR, function;
+	CPU_Pipeline_Reg reg;
+	ROB_Entry *e;
+	
+	for(n = 0; n < OOO_WIDTH; n++){
+		if(frontendHalted){
+			return;
+		}
+		if(frontendBlocked){
+			//wait until the branch/jump is resolved
+			e = &ROB[frontendBlocked - 1];
+			if(e->seq == frontendBlockSeq && !ooo_done(e)){
+				return;
+			}
+			frontendBlocked = 0;
+		}
+		if(robCount == OOO_ROB_SIZE){
+			OOO_ROB_FULL_STALLS++;
+			return;
+		}
+		IR = mem_read_32(NEXT_STATE.PC);
+		fu = is_memory_op(IR) ? FU_LS : (is_muldiv(IR) ? FU_MULDIV : FU_ALU);
+		if(rsUsed[fu] == OOO_RS_SIZE[fu]){
+			OOO_RS_FULL_STALLS++;
+			return;
+		}
+		if(fu == FU_LS && lsqUsed == OOO_LSQ_SIZE){
+			OOO_LSQ_FULL_STALLS++;
+			return;
+		}
+		
+		//Functional execution, in program order
+		memset(&reg, 0, sizeof(reg));
+		reg.IR = IR;
+		reg.PC = NEXT_STATE.PC;
+		NEXT_STATE.PC += 4;
+		take_delayed_branch();
+		decode_fields(&reg);
+		reg.A = NEXT_STATE.REGS[reg.registerRs];
+		reg.B = NEXT_STATE.REGS[reg.registerRt];
+		execute(&reg);
+		if(reg.memory_reference_load || reg.memory_reference_store){
+			REUSE_ACCESS(reg.ALUOutput); //program order
+		}
+		if(reg.memory_reference_load){
+			reg.LMD = mem_read_32(reg.ALUOutput);
+			WATCH_ACCESS(reg.PC, reg.ALUOutput, reg.LMD, WATCH_READ);
+		}else if(reg.memory_reference_store){
+			mem_write_32(reg.ALUOutput, reg.B);
+			WATCH_ACCESS(reg.PC, reg.ALUOutput, reg.B, WATCH_WRITE);
+			reg.LMD = 1; //SC always succeeds on a single core
+			//write-through: keep a resident copy of the block in sync
+			if(L1Cache.blocks[CACHE_INDEX(reg.ALUOutput)].valid && L1Cache.blocks[CACHE_INDEX(reg.ALUOutput)].tag == CACHE_TAG(reg.ALUOutput)){
+				L1Cache.blocks[CACHE_INDEX(reg.ALUOutput)].words[CACHE_WORD_OFFSET(reg.ALUOutput)] = reg.B;
+			}
+		}
+		writeback(&reg);
+		CURRENT_STATE = NEXT_STATE;
+		
+		//Allocate the ROB entry
+		idx = (robHead + robCount) % OOO_ROB_SIZE;
+		e = &ROB[idx];
+		memset(e, 0, sizeof(ROB_Entry));
+		e->seq = ++robSeq;
+		e->PC = reg.PC;
+		e->IR = IR;
+		e->fu = fu;
+		e->load = reg.memory_reference_load;
+		e->store = reg.memory_reference_store;
+		e->control = is_control(IR);
+		e->exitSyscall = reg.SYSCALL;
+		e->address = reg.ALUOutput & 0xFFFFFFFC;
+		
+		//Rename sources through the RAT
+		function = IR & 0x0000003F;
+		numSources = 0;
+		if(instruction_reads(IR, reg.registerRs)){
+			sources[numSources++] = reg.registerRs;
+		}
+		if(reg.registerRt != reg.registerRs && instruction_reads(IR, reg.registerRt)){
+			sources[numSources++] = reg.registerRt;
+		}
+		if(reg.opcode == 0x00 && function == 0x10){
+			sources[numSources++] = OOO_REG_HI; //MFHI
+		}else if(reg.opcode == 0x00 && function == 0x12){
+			sources[numSources++] = OOO_REG_LO; //MFLO
+		}
+		for(i = 0; i < numSources; i++){
+			e->srcIndex[i] = ratIndex[sources[i]];
+			e->srcSeq[i] = ratSeq[sources[i]];
+		}
+		e->numSources = numSources;
+		//Memory dependence on the youngest older store to the same word
+		if(e->load){
+			for(i = robCount - 1; i >= 0; i--){
+				ROB_Entry *older = &ROB[(robHead + i) % OOO_ROB_SIZE];
+				if(older->store && older->address == e->address){
+					e->srcIndex[e->numSources] = (robHead + i) % OOO_ROB_SIZE;
+					e->srcSeq[e->numSources] = older->seq;
+					e->numSources++;
+					e->forwarded = 1;
+					OOO_STORE_FORWARDS++;
+					break;
+				}
+			}
+		}
+		
+		//Rename destinations
+		if(instruction_dest(IR) != 0){
+			e->destReg[e->numDests++] = instruction_dest(IR);
+		}
+		if(reg.MULDIV || reg.MTHI){
+			e->destReg[e->numDests++] = OOO_REG_HI;
+		}
+		if(reg.MULDIV || reg.MTLO){
+			e->destReg[e->numDests++] = OOO_REG_LO;
+		}
+		for(i = 0; i < e->numDests; i++){
+			ratIndex[e->destReg[i]] = idx;
+			ratSeq[e->destReg[i]] = e->seq;
+		}
+		
+		robCount++;
+		rsUsed[fu]++;
+		if(e->load || e->store){
+			lsqUsed++;
+		}
+		if(e->exitSyscall){
+			//dispatch executes functionally, so stop before anything younger runs
+			frontendHalted = TRUE;
+			return;
+		}
+		if(e->control){
+			frontendBlocked = idx + 1;
+			frontendBlockSeq = e->seq;
+			return;
+		}
+	}
+}
+
+/************************************************************/
+/* empty the out-of-order core and clear its stats                                                */ 
+/************************************************************/
+void ooo_reset()
+{
+	int i;
+	
+	memset(ROB, 0, sizeof(ROB));
+	memset(MSHRS, 0, sizeof(MSHRS));
+	memset(rsUsed, 0, sizeof(rsUsed));
+	for(i = 0; i < OOO_NUM_REGS; i++){
+		ratIndex[i] = -1;
+	}
+	robHead = 0;
+	robCount = 0;
+	lsqUsed = 0;
+	frontendBlocked = 0;
+	frontendHalted = FALSE;
+	OOO_ROB_FULL_STALLS = 0;
+	OOO_RS_FULL_STALLS = 0;
+	OOO_LSQ_FULL_STALLS = 0;
+	OOO_MSHR_FULL_STALLS = 0;
+	OOO_MSHR_MERGES = 0;
+	OOO_STORE_FORWARDS = 0;
+	OOO_ROB_OCCUPANCY = 0;
+	OOO_MISSES_OUTSTANDING = 0;
+	OOO_MISS_CYCLES = 0;
+}
+
+/************************************************************/
+/* publish this thread's CORE_LOCAL state in CORES[id]                                          */ 
+/************************************************************/
+void register_core(int id)
+{
+	CORE_ID = id;
+	CORES[id].id = id;
+	CORES[id].state = &CURRENT_STATE;
+	CORES[id].cache = &L1Cache;
+	CORES[id].storeBuffer = &storeBuffer;
+	CORES[id].running = &RUN_FLAG;
+	CORES[id].instructions = &INSTRUCTION_COUNT;
+	CORES[id].cycles = &CYCLE_COUNT;
+	CORES[id].hits = &cache_hits;
+	CORES[id].misses = &cache_misses;
+}
+
+/************************************************************/
+/* simulate this core for up to n cycles                                                              */ 
+/************************************************************/
+void run_core(int n)
+{
+	int i;
+	for (i = 0; i < n && RUN_FLAG && !DEBUG_STOP; i++){
+		atomic_store(&CORES[CORE_ID].busPosition, BUS_POSITION(CYCLE_COUNT, CORE_ID));
+		cycle();
+		i += cycle_skip(n - i - 1);
+	}
+	atomic_store(&CORES[CORE_ID].busPosition, BUS_IDLE); //done for this quantum
+}
+
+/************************************************************/
+/* body of the host thread simulating core 1..CORE_COUNT-1                                  */ 
+/************************************************************/
+void *core_main(void *arg)
+{
+	register_core(((Core *)arg)->id);
+	while (1){
+		pthread_barrier_wait(&CORE_START);
+		if (CORE_COMMAND == CORE_EXIT){
+			break;
+		}
+		if (CORE_COMMAND == CORE_RESET){
+			reset_core();
+		}else {
+			run_core(CORE_COMMAND_CYCLES);
+		}
+		pthread_barrier_wait(&CORE_DONE);
+	}
+	return NULL;
+}
+
+/************************************************************/
+/* run one command on every core (core 0 is this thread) and wait for all of them     */ 
+/************************************************************/
+void core_step(int command, int cycles)
+{
+	int i;
+	
+	//every core's position is in place before any of them can ask for the bus
+	for (i = 0; i < CORE_COUNT; i++){
+		atomic_store(&CORES[i].busPosition, command == CORE_RUN && *CORES[i].running ? BUS_POSITION(*CORES[i].cycles, i) : BUS_IDLE);
+	}
+	CORE_COMMAND = command;
+	CORE_COMMAND_CYCLES = cycles;
+	pthread_barrier_wait(&CORE_START);
+	if (command == CORE_RESET){
+		reset_core();
+	}else {
+		run_core(cycles);
+	}
+	pthread_barrier_wait(&CORE_DONE);
+}
+
+/************************************************************/
+/* (re)start the simulation with n cores                                                               */ 
+/************************************************************/
+void start_cores(int n, int quantum)
+{
+	int i;
+	
+	if (n < 1 || n > MAX_CORES || quantum < 1){
+		printf("Invalid configuration (1..%d cores, quantum >= 1)\n", MAX_CORES);
+		return;
+	}
+	if (CYCLE_COUNT != 0){
+		printf("Program already started, reset before changing the number of cores\n");
+		return;
+	}
+	if (n > 1 && OOO_MODE){
+		printf("Multi-core simulation runs on the pipeline model, turn ooo off first\n");
+		return;
+	}
+	if (n > 1 && SPM_ON){
+		printf("The scratchpad is single-core, turn it off first\n");
+		return;
+	}
+	stop_cores();
+	CORE_COUNT = n;
+	CORE_QUANTUM = quantum;
+	if (n > 1){
+		pthread_barrier_init(&CORE_START, NULL, n);
+		pthread_barrier_init(&CORE_DONE, NULL, n);
+		for (i = 1; i < n; i++){
+			CORES[i].id = i;
+			pthread_create(&CORES[i].thread, NULL, core_main, &CORES[i]);
+		}
+	}
+	/*every core starts at MEM_TEXT_BEGIN with $k0/$k1 set*/
+	if (n > 1){
+		core_step(CORE_RESET, 0);
+	}else {
+		reset_core();
+	}
+}
+
+/************************************************************/
+/* join the core threads, back to a single core                                                      */ 
+/************************************************************/
+void stop_cores()
+{
+	int i;
+	
+	if (CORE_COUNT == 1){
+		return;
+	}
+	CORE_COMMAND = CORE_EXIT;
+	pthread_barrier_wait(&CORE_START);
+	for (i = 1; i < CORE_COUNT; i++){
+		pthread_join(CORES[i].thread, NULL);
+	}
+	pthread_barrier_destroy(&CORE_START);
+	pthread_barrier_destroy(&CORE_DONE);
+	CORE_COUNT = 1;
+}
+
+int any_core_running()
+{
+	int i;
+	for (i = 0; i < CORE_COUNT; i++){
+		if (*CORES[i].running){
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/************************************************************/
+/* the bus is only contended with more than one core. During a run it is taken in         */
+/* BUS_POSITION order: wait until no other core can still use it earlier                  */
+/************************************************************/
+void bus_lock()
+{
+	int i;
+	uint64_t position;
+	
+	if (CORE_COUNT == 1){
+		return;
+	}
+	position = atomic_load(&CORES[CORE_ID].busPosition);
+	if (position != BUS_IDLE){
+		//positions only grow during a run, so each core needs to be checked once
+		for (i = 0; i < CORE_COUNT; i++){
+			while (i != CORE_ID && atomic_load(&CORES[i].busPosition) < position){
+				CORES[CORE_ID].busWaits++;
+				sched_yield();
+			}
+		}
+	}
+	pthread_mutex_lock(&BUS_LOCK);
+}
+
+void bus_unlock()
+{
+	if (CORE_COUNT > 1){
+		pthread_mutex_unlock(&BUS_LOCK);
+	}
+}
+
+/************************************************************/
+/* Other caches react to a bus transaction for blockAddress (BUS_LOCK held).             */
+/* Returns TRUE if another cache still holds a copy afterwards.                              */ 
+/************************************************************/
+int snoop(int transaction, uint32_t blockAddress)
+{
+	int i, victim, shared = FALSE;
+	CacheBlock *block;
+	
+	for (i = 0; i < CORE_COUNT; i++){
+		if (i == CORE_ID){
+			continue;
+		}
+		//memory has to be current before anyone reads or takes over the block
+		store_buffer_flush(CORES[i].storeBuffer, blockAddress);
+		//a write by anyone else breaks the LL/SC link
+		if (transaction != BUS_READ && CORES[i].llValid && CACHE_BLOCK_ADDRESS(CORES[i].llAddress) == blockAddress){
+			CORES[i].llValid = 0;
+		}
+		block = &CORES[i].cache->blocks[CACHE_INDEX(blockAddress)];
+		victim = -1;
+		if (!block->valid || block->tag != CACHE_TAG(blockAddress)){
+			//it may be sitting in the victim buffer instead
+			victim = victim_find(CORES[i].cache, blockAddress);
+			if (victim < 0){
+				continue;
+			}
+			block = &CORES[i].cache->victims[victim].block;
+		}
+		if (transaction == BUS_READ){
+			//memory is kept up to date (write-through), so M/E just drop to S
+			if (block->state == MESI_MODIFIED || block->state == MESI_EXCLUSIVE){
+				CORES[i].interventions++;
+			}
+			block->state = MESI_SHARED;
+			shared = TRUE;
+		}else {
+			block->state = MESI_INVALID;
+			block->valid = 0;
+			if (victim >= 0){
+				CORES[i].cache->victimTags.valid[victim] = 0;
+			}
+			CORES[i].invalidations++;
+		}
+	}
+	return shared;
+}
+
+/************************************************************/
+/* stop the run if an instruction retires at a breakpoint                                            */ 
+/************************************************************/
+void break_check(uint32_t pc)
+{
+	int i;
+	
+	for (i = 0; i < BREAKPOINT_COUNT; i++){
+		if (BREAKPOINTS[i] == pc){
+			printf("\nBreakpoint %d at 0x%08x, core %d, cycle %u\n", i, pc, CORE_ID, CYCLE_COUNT);
+			DEBUG_STOP = TRUE;
+			return;
+		}
+	}
+}
+
+/************************************************************/
+/* a guest load/store touched a watched page, see if a watchpoint fires                  */ 
+/************************************************************/
+void watch_check(uint32_t pc, uint32_t address, uint32_t value, int type)
+{
+	int i;
+	Watchpoint *w;
+	
+	for (i = 0; i < MAX_WATCHPOINTS; i++){
+		w = &WATCHPOINTS[i];
+		if (!w->valid || !(w->type & type) || address + 3 < w->start || address > w->end){
+			continue;
+		}
+		if (w->conditional && w->value != value){
+			continue;
+		}
+		printf("\nWatchpoint %d: %s 0x%08x = 0x%08x, PC 0x%08x, core %d, cycle %u\n", i,
+			type == WATCH_WRITE ? "store to" : "load from", address, value, pc, CORE_ID, CYCLE_COUNT);
+		DEBUG_STOP = TRUE;
+	}
+}
+
+void add_breakpoint(uint32_t pc)
+{
+	if (BREAKPOINT_COUNT == MAX_BREAKPOINTS){
+		printf("Too many breakpoints (%d)\n", MAX_BREAKPOINTS);
+		return;
+	}
+	BREAKPOINTS[BREAKPOINT_COUNT] = pc;
+	printf("Breakpoint %d at 0x%08x\n", BREAKPOINT_COUNT, pc);
+	BREAKPOINT_COUNT++;
+}
+
+void add_watchpoint(int type, uint32_t start, uint32_t end, int conditional, uint32_t value)
+{
+	int i;
+	
+	if (type == 0 || end < start){
+		printf("Invalid watchpoint (type r, w or rw; end >= start)\n");
+		return;
+	}
+	for (i = 0; i < MAX_WATCHPOINTS; i++){
+		if (!WATCHPOINTS[i].valid){
+			break;
+		}
+	}
+	if (i == MAX_WATCHPOINTS){
+		printf("Too many watchpoints (%d)\n", MAX_WATCHPOINTS);
+		return;
+	}
+	WATCHPOINTS[i].valid = 1;
+	WATCHPOINTS[i].type = type;
+	WATCHPOINTS[i].start = start;
+	WATCHPOINTS[i].end = end;
+	WATCHPOINTS[i].conditional = conditional;
+	WATCHPOINTS[i].value = value;
+	watch_pages_update();
+	printf("Watchpoint %d on 0x%08x..0x%08x\n", i, start, end);
+}
+
+/************************************************************/
+/* rebuild the per-page flags from the watchpoint list                                                 */ 
+/************************************************************/
+void watch_pages_update()
+{
+	int i;
+	uint32_t page;
+	
+	if (WATCH_PAGES == NULL){
+		WATCH_PAGES = calloc(WATCH_NUM_PAGES, 1);
+	}else {
+		memset(WATCH_PAGES, 0, WATCH_NUM_PAGES);
+	}
+	WATCHPOINT_COUNT = 0;
+	for (i = 0; i < MAX_WATCHPOINTS; i++){
+		if (!WATCHPOINTS[i].valid){
+			continue;
+		}
+		WATCHPOINT_COUNT++;
+		//a word access can start up to 3 bytes before the range
+		page = (WATCHPOINTS[i].start >= 3 ? WATCHPOINTS[i].start - 3 : 0) >> WATCH_PAGE_SHIFT;
+		for (; page <= (WATCHPOINTS[i].end >> WATCH_PAGE_SHIFT); page++){
+			WATCH_PAGES[page] |= WATCHPOINTS[i].type;
+		}
+	}
+}
+
+void delete_debug_points()
+{
+	BREAKPOINT_COUNT = 0;
+	memset(WATCHPOINTS, 0, sizeof(WATCHPOINTS));
+	WATCHPOINT_COUNT = 0;
+	printf("All breakpoints and watchpoints deleted\n");
+}
+
+void list_debug_points()
+{
+	int i;
+	
+	for (i = 0; i < BREAKPOINT_COUNT; i++){
+		printf("Breakpoint %d\t: 0x%08x\n", i, BREAKPOINTS[i]);
+	}
+	for (i = 0; i < MAX_WATCHPOINTS; i++){
+		if (!WATCHPOINTS[i].valid){
+			continue;
+		}
+		printf("Watchpoint %d\t: %s%s 0x%08x..0x%08x", i, WATCHPOINTS[i].type & WATCH_READ ? "r" : "", WATCHPOINTS[i].type & WATCH_WRITE ? "w" : "",
+			WATCHPOINTS[i].start, WATCHPOINTS[i].end);
+		WATCHPOINTS[i].conditional ? printf(" == 0x%08x\n", WATCHPOINTS[i].value) : printf("\n");
+	}
+}
+
+/* "r", "w" or "rw" to WATCH_READ/WATCH_WRITE bits, 0 if invalid */
+int parse_watch_type(char *s)
+{
+	if (strcmp(s, "r") == 0) return WATCH_READ;
+	if (strcmp(s, "w") == 0) return WATCH_WRITE;
+	if (strcmp(s, "rw") == 0 || strcmp(s, "wr") == 0) return WATCH_READ | WATCH_WRITE;
+	return 0;
+}
+
+/************************************************************/
+/* reference checker: start over from the current state (cycle 0)                           */ 
+/************************************************************/
+void check_start()
+{
+	int i;
+	
+	if (CORE_COUNT > 1 || OOO_MODE){
+		printf("Reference check only runs on the single-core pipeline, turning it off\n");
+		CHECKING = FALSE;
+		return;
+	}
+	if (REF_MEMORY == NULL){
+		REF_MEMORY = calloc(REF_NUM_PAGES, sizeof(uint8_t *));
+	}
+	for (i = 0; i < REF_NUM_PAGES; i++){
+		if (REF_MEMORY[i] != NULL){
+			free(REF_MEMORY[i]);
+			REF_MEMORY[i] = NULL;
+		}
+	}
+	REF_STATE = CURRENT_STATE;
+	refLinkValid = 0;
+	refHalted = FALSE;
+	refSlotPending = FALSE;
+	checkCount = 0;
+	CHECK_FAILED = FALSE;
+	CHECKED_COMMITS = 0;
+}
+
+/************************************************************/
+/* reference checker: log what an instruction did as it retires                                   */ 
+/************************************************************/
+void check_commit(CPU_Pipeline_Reg *reg)
+{
+	Commit *c;
+	
+	if (CHECK_FAILED){
+		return;
+	}
+	c = &CHECK_LOG[checkCount++];
+	c->cycle = CYCLE_COUNT;
+	c->PC = reg->PC;
+	c->IR = reg->IR;
+	c->dest = instruction_dest(reg->IR);
+	c->value = NEXT_STATE.REGS[c->dest];
+	c->HI = NEXT_STATE.HI;
+	c->LO = NEXT_STATE.LO;
+	c->store = reg->memory_reference_store && !(reg->LLSC && !reg->LMD); //a failed SC writes nothing
+	c->address = reg->ALUOutput;
+	c->data = reg->B;
+	if (checkCount >= CHECK_BATCH){
+		check_flush();
+	}
+}
+
+/************************************************************/
+/* reference checker: replay the log, then compare the whole register file and the      */
+/* memory words the batch stored to                                                                        */ 
+/************************************************************/
+void check_flush()
+{
+	int i, n = checkCount;
+	uint32_t address;
+	
+	checkCount = 0;
+	if (CHECK_FAILED || n == 0){
+		return;
+	}
+	for (i = 0; i < n; i++){
+		if (ref_step(&CHECK_LOG[i])){
+			CHECK_FAILED = TRUE;
+			DEBUG_STOP = TRUE;
+			return;
+		}
+		CHECKED_COMMITS++;
+	}
+	for (i = 0; i < MIPS_REGS; i++){
+		if (NEXT_STATE.REGS[i] != REF_STATE.REGS[i]){
+			printf("\nReference check FAILED after commit %u (cycle %u): $%d pipeline 0x%08x, reference 0x%08x\n",
+				CHECKED_COMMITS, CHECK_LOG[n - 1].cycle, i, NEXT_STATE.REGS[i], REF_STATE.REGS[i]);
+			CHECK_FAILED = TRUE;
+		}
+	}
+	for (i = 0; i < n; i++){
+		address = CHECK_LOG[i].address & ~3;
+		if (CHECK_LOG[i].store && mem_read_visible(address) != ref_read(address)){
+			printf("\nReference check FAILED after commit %u (cycle %u): memory 0x%08x pipeline 0x%08x, reference 0x%08x\n",
+				CHECKED_COMMITS, CHECK_LOG[n - 1].cycle, address, mem_read_visible(address), ref_read(address));
+			CHECK_FAILED = TRUE;
+			break;
 		}
-	}else if(EX_MEM.opcode == 0x00){
-		switch(EX_MEM.function){
-			case 0x9: //JALR
-				stalling = 1;
+	}
+	if (CHECK_FAILED){
+		DEBUG_STOP = TRUE;
+	}
+}
+
+/************************************************************/
+/* reference checker: the pipeline is about to store to this address, keep the page     */
+/* as it was for the reference                                                                               */ 
+/************************************************************/
+void check_snapshot(uint32_t address)
+{
+	ref_page(address);
+}
+
+/************************************************************/
+/* reference checker: the reference's copy of a page, made on first use                       */ 
+/************************************************************/
+uint8_t *ref_page(uint32_t address)
+{
+	uint32_t i, base = address & ~(REF_PAGE_SIZE - 1), word;
+	uint8_t *page = REF_MEMORY[address >> REF_PAGE_SHIFT];
+	
+	if (page == NULL){
+		page = malloc(REF_PAGE_SIZE);
+		for (i = 0; i < REF_PAGE_SIZE; i += 4){
+			word = mem_read_32(base + i);
+			page[i + 0] = (word >> 0) & 0xFF;
+			page[i + 1] = (word >> 8) & 0xFF;
+			page[i + 2] = (word >> 16) & 0xFF;
+			page[i + 3] = (word >> 24) & 0xFF;
+		}
+		REF_MEMORY[address >> REF_PAGE_SHIFT] = page;
+	}
+	return page;
+}
+
+/* aligned word of the reference memory */
+uint32_t ref_read(uint32_t address)
+{
+	uint8_t *page = REF_MEMORY[address >> REF_PAGE_SHIFT];
+	uint32_t offset = address & (REF_PAGE_SIZE - 4);
+	
+	if (page == NULL){
+		return mem_read_32(address & ~3);
+	}
+	return page[offset] | (page[offset + 1] << 8) | (page[offset + 2] << 16) | ((uint32_t)page[offset + 3] << 24);
+}
+
+/* store size bytes (1, 2 or 4) of value at address into the reference memory */
+void ref_write(uint32_t address, uint32_t value, int size)
+{
+	int i;
+	uint8_t *page = ref_page(address);
+	
+	for (i = 0; i < size; i++){
+		page[(address + i) & (REF_PAGE_SIZE - 1)] = (value >> (8 * i)) & 0xFF;
+	}
+}
+
+/************************************************************/
+/* reference checker: execute one instruction the plain way and compare it with      */
+/* the commit record. Returns TRUE on a mismatch (after printing it).                       */ 
+/************************************************************/
+int ref_step(Commit *c)
+{
+	uint32_t *r = REF_STATE.REGS;
+	uint32_t pc = REF_STATE.PC, next = pc + 4;
+	uint32_t ir, opcode, rs, rt, rd, sa, function, uimm;
+	uint32_t dest = 0, value = 0, address = 0, data = 0, word, shift;
+	int32_t imm;
+	int size = 0, store = FALSE, known = TRUE;
+	uint64_t product;
+	
+	if (refHalted){
+		printf("\nReference check FAILED at commit %u (cycle %u): pipeline retired PC 0x%08x after the exit SYSCALL\n", CHECKED_COMMITS, c->cycle, c->PC);
+		return TRUE;
+	}
+	if (c->PC != pc){
+		printf("\nReference check FAILED at commit %u (cycle %u): pipeline retired PC 0x%08x, reference is at 0x%08x\n", CHECKED_COMMITS, c->cycle, c->PC, pc);
+		return TRUE;
+	}
+	ir = ref_read(pc);
+	opcode = ir >> 26;
+	rs = (ir >> 21) & 0x1F;
+	rt = (ir >> 16) & 0x1F;
+	rd = (ir >> 11) & 0x1F;
+	sa = (ir >> 6) & 0x1F;
+	function = ir & 0x3F;
+	uimm = ir & 0xFFFF;
+	imm = (int16_t)uimm;
+	
+	if (opcode == 0x00){
+		switch (function){
+			case 0x00: dest = rd; value = r[rt] << sa; break; //SLL
+			case 0x02: dest = rd; value = r[rt] >> sa; break; //SRL
+			case 0x03: dest = rd; value = (uint32_t)((int32_t)r[rt] >> sa); break; //SRA
+			case 0x04: dest = rd; value = r[rt] << (r[rs] & 0x1F); break; //SLLV
+			case 0x06: dest = rd; value = r[rt] >> (r[rs] & 0x1F); break; //SRLV
+			case 0x07: dest = rd; value = (uint32_t)((int32_t)r[rt] >> (r[rs] & 0x1F)); break; //SRAV
+			case 0x08: next = r[rs]; break; //JR
+			case 0x09: dest = rd; value = pc + (DELAY_SLOT ? 8 : 4); next = r[rs]; break; //JALR
+			case 0x0C: //SYSCALL
+				dest = 2;
+				value = r[2];
+				if (r[2] == SYS_READ_INT || r[2] == SYS_READ_CHAR || r[2] == SYS_SBRK){
+					value = c->value; //host input and the heap are not replayed
+				}
+				if (r[2] == SYS_EXIT || r[2] == SYS_EXIT2){
+					refHalted = TRUE;
+				}
 				break;
-			case 0x8: //JR
-				stalling = 1;
+			case 0x10: dest = rd; value = REF_STATE.HI; break; //MFHI
+			case 0x11: REF_STATE.HI = r[rs]; break; //MTHI
+			case 0x12: dest = rd; value = REF_STATE.LO; break; //MFLO
+			case 0x13: REF_STATE.LO = r[rs]; break; //MTLO
+			case 0x18: //MULT
+				product = (uint64_t)((int64_t)(int32_t)r[rs] * (int64_t)(int32_t)r[rt]);
+				REF_STATE.HI = product >> 32;
+				REF_STATE.LO = product & 0xFFFFFFFF;
 				break;
-			default:
-				stalling = 0;
+			case 0x19: //MULTU
+				product = (uint64_t)r[rs] * (uint64_t)r[rt];
+				REF_STATE.HI = product >> 32;
+				REF_STATE.LO = product & 0xFFFFFFFF;
+				break;
+			case 0x1A: //DIV
+				if (r[rt] == 0){
+					REF_STATE.HI = c->HI; //unpredictable, take whatever the pipeline left
+					REF_STATE.LO = c->LO;
+				}else if (r[rs] == 0x80000000 && r[rt] == 0xFFFFFFFF){
+					REF_STATE.LO = 0x80000000;
+					REF_STATE.HI = 0;
+				}else {
+					REF_STATE.LO = (uint32_t)((int32_t)r[rs] / (int32_t)r[rt]);
+					REF_STATE.HI = (uint32_t)((int32_t)r[rs] % (int32_t)r[rt]);
+				}
 				break;
+			case 0x1B: //DIVU
+				if (r[rt] == 0){
+					REF_STATE.HI = c->HI;
+					REF_STATE.LO = c->LO;
+				}else {
+					REF_STATE.LO = r[rs] / r[rt];
+					REF_STATE.HI = r[rs] % r[rt];
+				}
+				break;
+			//no exceptions in this simulator, so ADD/SUB do not trap on overflow
+			case 0x20: case 0x21: dest = rd; value = r[rs] + r[rt]; break; //ADD, ADDU
+			case 0x22: case 0x23: dest = rd; value = r[rs] - r[rt]; break; //SUB, SUBU
+			case 0x24: dest = rd; value = r[rs] & r[rt]; break; //AND
+			case 0x25: dest = rd; value = r[rs] | r[rt]; break; //OR
+			case 0x26: dest = rd; value = r[rs] ^ r[rt]; break; //XOR
+			case 0x27: dest = rd; value = ~(r[rs] | r[rt]); break; //NOR
+			case 0x2A: dest = rd; value = (int32_t)r[rs] < (int32_t)r[rt]; break; //SLT
+			case 0x2B: dest = rd; value = r[rs] < r[rt]; break; //SLTU
+			default: known = FALSE; break;
 		}
-	}else if(EX_MEM.opcode == 0x1){
-		switch(EX_MEM.registerRt){
-			case 0x1: //BGEZ
-				stalling = 1;
+	}else {
+		switch (opcode){
+			case 0x01: //BLTZ, BGEZ
+				if ((rt == 0x00 && (int32_t)r[rs] < 0) || (rt == 0x01 && (int32_t)r[rs] >= 0)){
+					next = pc + 4 + (imm << 2);
+				}
+				known = (rt == 0x00 || rt == 0x01);
 				break;
-			case 0x0: //BLTZ
-				stalling = 1;
+			case 0x02: next = ((pc + 4) & 0xF0000000) | ((ir & 0x03FFFFFF) << 2); break; //J
+			case 0x03: dest = 31; value = pc + (DELAY_SLOT ? 8 : 4); next = ((pc + 4) & 0xF0000000) | ((ir & 0x03FFFFFF) << 2); break; //JAL
+			case 0x04: if (r[rs] == r[rt]) next = pc + 4 + (imm << 2); break; //BEQ
+			case 0x05: if (r[rs] != r[rt]) next = pc + 4 + (imm << 2); break; //BNE
+			case 0x06: if ((int32_t)r[rs] <= 0) next = pc + 4 + (imm << 2); break; //BLEZ
+			case 0x07: if ((int32_t)r[rs] > 0) next = pc + 4 + (imm << 2); break; //BGTZ
+			case 0x08: case 0x09: dest = rt; value = r[rs] + imm; break; //ADDI, ADDIU
+			case 0x0A: dest = rt; value = (int32_t)r[rs] < imm; break; //SLTI
+			case 0x0B: dest = rt; value = r[rs] < (uint32_t)imm; break; //SLTIU
+			case 0x0C: dest = rt; value = r[rs] & uimm; break; //ANDI
+			case 0x0D: dest = rt; value = r[rs] | uimm; break; //ORI
+			case 0x0E: dest = rt; value = r[rs] ^ uimm; break; //XORI
+			case 0x0F: dest = rt; value = uimm << 16; break; //LUI
+			case 0x20: case 0x21: case 0x23: case 0x24: case 0x25: case 0x30: //LB, LH, LW, LBU, LHU, LL
+				address = r[rs] + imm;
+				word = DMA_REGISTER(address) ? c->value : ref_read(address); //the reference has no DMA engine
+				shift = 8 * (address & 3);
+				dest = rt;
+				switch (opcode){
+					case 0x20: value = (uint32_t)(int8_t)(word >> shift); break;
+					case 0x21: value = (uint32_t)(int16_t)(word >> shift); break;
+					case 0x24: value = (word >> shift) & 0xFF; break;
+					case 0x25: value = (word >> shift) & 0xFFFF; break;
+					default: value = word; break;
+				}
+				if (opcode == 0x30){
+					refLinkValid = 1;
+					refLinkAddress = address;
+				}
 				break;
-			default:
-				stalling = 0;
+			case 0x28: case 0x29: case 0x2B: //SB, SH, SW
+				address = r[rs] + imm;
+				size = (opcode == 0x28) ? 1 : (opcode == 0x29) ? 2 : 4;
+				data = (size == 4) ? r[rt] : r[rt] & ((1u << (8 * size)) - 1);
+				store = TRUE;
 				break;
+			case 0x38: //SC
+				address = r[rs] + imm;
+				dest = rt;
+				value = refLinkValid && refLinkAddress == address;
+				refLinkValid = 0;
+				if (value){
+					size = 4;
+					data = r[rt];
+					store = TRUE;
+				}
+				break;
+			default: known = FALSE; break;
+		}
+	}
+	
+	if (!known){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x: instruction 0x%08x is not a MIPS instruction the reference knows\n", CHECKED_COMMITS, c->cycle, pc, ir);
+		return TRUE;
+	}
+	if (c->IR != ir){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x: pipeline retired 0x%08x, memory holds 0x%08x\n", CHECKED_COMMITS, c->cycle, pc, c->IR, ir);
+		return TRUE;
+	}
+	if (dest != c->dest && (dest != 0 || c->dest != 0)){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x: writes $%u in the pipeline, $%u in the reference\n", CHECKED_COMMITS, c->cycle, pc, c->dest, dest);
+		return TRUE;
+	}
+	if (dest != 0 && value != c->value){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x:", CHECKED_COMMITS, c->cycle, pc);
+		print_instruction(pc);
+		printf("\n  $%u pipeline 0x%08x, reference 0x%08x\n", dest, c->value, value);
+		return TRUE;
+	}
+	if (REF_STATE.HI != c->HI || REF_STATE.LO != c->LO){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x:", CHECKED_COMMITS, c->cycle, pc);
+		print_instruction(pc);
+		printf("\n  HI/LO pipeline 0x%08x/0x%08x, reference 0x%08x/0x%08x\n", c->HI, c->LO, REF_STATE.HI, REF_STATE.LO);
+		return TRUE;
+	}
+	if (store != c->store || (store && (address != c->address || data != (c->data & (size == 4 ? 0xFFFFFFFF : (1u << (8 * size)) - 1))))){
+		printf("\nReference check FAILED at commit %u (cycle %u), PC 0x%08x:", CHECKED_COMMITS, c->cycle, pc);
+		print_instruction(pc);
+		printf("\n  store pipeline %s0x%08x = 0x%08x, reference %s0x%08x = 0x%08x\n", c->store ? "" : "(none) ", c->address, c->data,
+			store ? "" : "(none) ", address, data);
+		return TRUE;
+	}
+	
+	if (dest != 0){
+		r[dest] = value;
+	}
+	if (store && !DMA_REGISTER(address)){ //a DMA register store went to the engine, not memory
+		ref_write(address, data, size);
+	}
+	if (refSlotPending){
+		//this was the delay slot of the previous branch
+		next = refSlotTarget;
+		refSlotPending = FALSE;
+	}else if (DELAY_SLOT && next != pc + 4){
+		refSlotPending = TRUE;
+		refSlotTarget = next;
+		next = pc + 4;
+	}
+	REF_STATE.PC = next;
+	return FALSE;
+}
+
+/************************************************************/
+/* turn the reference checker on/off, batch = commits per replay                                */ 
+/************************************************************/
+void set_checking(int on, int batch)
+{
+	if (batch < 1 || batch > MAX_CHECK_BATCH){
+		printf("Invalid batch size (1..%d)\n", MAX_CHECK_BATCH);
+		return;
+	}
+	if (CYCLE_COUNT != 0){
+		printf("Program already started, reset before turning the reference check on or off\n");
+		return;
+	}
+	CHECKING = (on != 0);
+	CHECK_BATCH = batch;
+}
+
+/************************************************************/
+/* Initialize Memory                                                                                                    */ 
+/************************************************************/
+void initialize() { 
+	init_memory();
+	CURRENT_STATE.PC = MEM_TEXT_BEGIN;
+	NEXT_STATE = CURRENT_STATE;
+	RUN_FLAG = TRUE;
+	ooo_reset();
+	register_core(0);
+}
+
+/************************************************************/
+/* profiler: start counting from scratch (on) or drop the counters (off)                        */ 
+/************************************************************/
+void set_profiling(int on, int top)
+{
+	if (top < 1){
+		printf("Invalid report size (top >= 1)\n");
+		return;
+	}
+	free(PROFILE_DATA);
+	PROFILE_DATA = NULL;
+	PROFILE_SIZE = 0;
+	PROFILE_TOP = top;
+	if (on){
+		PROFILE_SIZE = PROGRAM_SIZE;
+		PROFILE_DATA = calloc(PROFILE_SIZE, sizeof(Profile_Entry));
+	}
+}
+
+void profile_reset()
+{
+	if (PROFILE_DATA != NULL){
+		memset(PROFILE_DATA, 0, PROFILE_SIZE * sizeof(Profile_Entry));
+	}
+}
+
+/* hottest first: cycles an instruction accounts for are its retires plus its stalls */
+int profile_compare(const void *a, const void *b)
+{
+	const Profile_Entry *x = &PROFILE_DATA[*(const uint32_t *)a];
+	const Profile_Entry *y = &PROFILE_DATA[*(const uint32_t *)b];
+	uint64_t costX = (uint64_t)x->count + x->stalls, costY = (uint64_t)y->count + y->stalls;
+	
+	return (costX < costY) - (costX > costY);
+}
+
+int profile_block_compare(const void *a, const void *b)
+{
+	const Profile_Block *x = a, *y = b;
+	uint64_t costX = (uint64_t)x->instructions + x->stalls, costY = (uint64_t)y->instructions + y->stalls;
+	
+	return (costX < costY) - (costX > costY);
+}
+
+/************************************************************/
+/* profiler: top-N instructions, then top-N basic blocks                                          */ 
+/************************************************************/
+void print_profile()
+{
+	uint32_t i, n = 0, *order;
+	uint64_t count = 0, stalls = 0, misses = 0;
+	Profile_Entry *p;
+	
+	if (PROFILE_DATA == NULL){
+		printf("Profiling is off\n");
+		return;
+	}
+	order = malloc(PROFILE_SIZE * sizeof(uint32_t));
+	for (i = 0; i < PROFILE_SIZE; i++){
+		p = &PROFILE_DATA[i];
+		count += p->count;
+		stalls += p->stalls;
+		misses += p->misses;
+		if (p->count != 0 || p->stalls != 0){
+			order[n++] = i;
+		}
+	}
+	qsort(order, n, sizeof(uint32_t), profile_compare);
+	
+	printf("-------------------------------------\n");
+	printf("Hot spots: %llu instructions, %llu stall cycles, %llu D-cache misses\n", (unsigned long long)count,
+		(unsigned long long)stalls, (unsigned long long)misses);
+	printf("-------------------------------------\n");
+	printf("[PC]\t\t[Count]\t[Stalls]\t[Misses]\t[%%Cost]\t[Instruction]\n");
+	for (i = 0; i < n && i < (uint32_t)PROFILE_TOP; i++){
+		p = &PROFILE_DATA[order[i]];
+		printf("0x%08x\t%u\t%u\t\t%u\t\t%.2f\t", MEM_TEXT_BEGIN + (order[i] << 2), p->count, p->stalls, p->misses,
+			100.0 * ((uint64_t)p->count + p->stalls) / (count + stalls));
+		print_instruction(MEM_TEXT_BEGIN + (order[i] << 2));
+	}
+	free(order);
+	print_profile_blocks();
+}
+
+/************************************************************/
+/* profiler: the same counts summed per basic block                                                */ 
+/************************************************************/
+void print_profile_blocks()
+{
+	uint32_t i, n = 0;
+	uint8_t *leaders = calloc(PROFILE_SIZE + 1, 1);
+	Profile_Block *blocks = calloc(PROFILE_SIZE, sizeof(Profile_Block));
+	Profile_Block *b = NULL;
+	Profile_Entry *p;
+	
+	profile_leaders(leaders);
+	for (i = 0; i < PROFILE_SIZE; i++){
+		p = &PROFILE_DATA[i];
+		if (leaders[i]){
+			b = &blocks[n++];
+			b->start = MEM_TEXT_BEGIN + (i << 2);
+			b->entries = p->count;
+		}
+		b->end = MEM_TEXT_BEGIN + (i << 2);
+		b->instructions += p->count;
+		b->stalls += p->stalls;
+		b->misses += p->misses;
+	}
+	qsort(blocks, n, sizeof(Profile_Block), profile_block_compare);
+	
+	printf("-------------------------------------\n");
+	printf("[Block]\t\t\t\t[Entries]\t[Instr]\t[Stalls]\t[Misses]\n");
+	for (i = 0; i < n && i < (uint32_t)PROFILE_TOP && blocks[i].instructions + blocks[i].stalls != 0; i++){
+		b = &blocks[i];
+		printf("0x%08x-0x%08x\t%u\t\t%u\t%u\t\t%u\n", b->start, b->end, b->entries, b->instructions, b->stalls, b->misses);
+	}
+	free(blocks);
+	free(leaders);
+}
+
+/************************************************************/
+/* profiler: mark the first instruction of every basic block (program start, branch/jump */
+/* targets and whatever follows a branch, jump or SYSCALL)                                       */ 
+/************************************************************/
+void profile_leaders(uint8_t *leaders)
+{
+	uint32_t i, instruction, opcode, target;
+	
+	leaders[0] = 1;
+	for (i = 0; i < PROFILE_SIZE; i++){
+		instruction = mem_read_32(MEM_TEXT_BEGIN + (i << 2));
+		if (!is_control(instruction)){
+			continue;
+		}
+		leaders[i + 1] = 1;
+		opcode = (instruction & 0xFC000000) >> 26;
+		if (opcode == 0x02 || opcode == 0x03){ //J, JAL
+			target = ((MEM_TEXT_BEGIN + (i << 2)) & 0xF0000000) | ((instruction & 0x03FFFFFF) << 2);
+		}else if (opcode != 0x00){ //branches, JR/JALR targets are not known
+			target = MEM_TEXT_BEGIN + ((i + 1) << 2) + ((int16_t)(instruction & 0xFFFF) << 2);
+		}else {
+			continue;
+		}
+		if (PROFILE_INDEX(target) < PROFILE_SIZE){
+			leaders[PROFILE_INDEX(target)] = 1;
+		}
+	}
+}
+
+/************************************************************/
+/* reuse analyzer: one data access (block granularity)                                                */ 
+/************************************************************/
+void reuse_access(uint32_t address)
+{
+	uint32_t blockAddress = CACHE_BLOCK_ADDRESS(address);
+	uint32_t window = INSTRUCTION_COUNT / REUSE_WINDOW;
+	uint32_t distance;
+	int bucket;
+	Reuse_Slot *slot;
+	
+	if (window != wsWindow){
+		reuse_window_done();
+		wsWindow = window;
+	}
+	if ((REUSE_BLOCKS + 1) * 2 > reuseTableSize){
+		reuse_grow_table();
+	}
+	if (reuseNow == reuseTreeSize){
+		reuse_compact();
+	}
+	slot = reuse_slot(blockAddress);
+	REUSE_ACCESSES++;
+	if (slot->used){
+		//distinct blocks whose latest access lies between the two accesses to this one
+		distance = reuse_prefix(reuseNow) - reuse_prefix(slot->time + 1);
+		for (bucket = 0; bucket < REUSE_BUCKETS - 1 && (distance >> bucket) != 0; bucket++);
+		REUSE_HISTOGRAM[bucket]++;
+		reuse_add(slot->time + 1, -1);
+	}else {
+		slot->used = 1;
+		slot->blockAddress = blockAddress;
+		slot->window = 0;
+		REUSE_BLOCKS++;
+		REUSE_COLD++;
+	}
+	if (slot->window != wsWindow + 1){
+		slot->window = wsWindow + 1;
+		wsBlocks++;
+	}
+	slot->time = reuseNow;
+	reuse_add(reuseNow + 1, 1);
+	reuseNow++;
+}
+
+/* slot holding the block, or the free slot it goes in */
+Reuse_Slot *reuse_slot(uint32_t blockAddress)
+{
+	uint32_t i = ((blockAddress >> 4) * 2654435761u) & (reuseTableSize - 1);
+	
+	while (reuseTable[i].used && reuseTable[i].blockAddress != blockAddress){
+		i = (i + 1) & (reuseTableSize - 1);
+	}
+	return &reuseTable[i];
+}
+
+void reuse_grow_table()
+{
+	uint32_t i, oldSize = reuseTableSize;
+	Reuse_Slot *old = reuseTable;
+	
+	reuseTableSize *= 2;
+	reuseTable = calloc(reuseTableSize, sizeof(Reuse_Slot));
+	for (i = 0; i < oldSize; i++){
+		if (old[i].used){
+			*reuse_slot(old[i].blockAddress) = old[i];
+		}
+	}
+	free(old);
+}
+
+/* marks at timeline positions 0..k-1 */
+uint32_t reuse_prefix(uint32_t k)
+{
+	uint32_t sum = 0;
+	
+	for (; k > 0; k -= k & -k){
+		sum += reuseTree[k];
+	}
+	return sum;
+}
+
+void reuse_add(uint32_t k, int delta)
+{
+	for (; k <= reuseTreeSize; k += k & -k){
+		reuseTree[k] += delta;
+	}
+}
+
+/************************************************************/
+/* reuse analyzer: timeline is full, renumber the blocks' latest accesses 0..blocks-1   */
+/* in order (distances do not change), doubling the timeline if they fill half of it     */ 
+/************************************************************/
+void reuse_compact()
+{
+	uint32_t i, n = 0;
+	Reuse_Slot **order = malloc(REUSE_BLOCKS * sizeof(Reuse_Slot *));
+	
+	for (i = 0; i < reuseTableSize; i++){
+		if (reuseTable[i].used){
+			order[n++] = &reuseTable[i];
+		}
+	}
+	qsort(order, n, sizeof(Reuse_Slot *), reuse_time_compare);
+	while (n * 2 > reuseTreeSize){
+		reuseTreeSize *= 2;
+	}
+	free(reuseTree);
+	reuseTree = calloc(reuseTreeSize + 1, sizeof(uint32_t));
+	for (i = 0; i < n; i++){
+		order[i]->time = i;
+		reuse_add(i + 1, 1);
+	}
+	reuseNow = n;
+	free(order);
+}
+
+int reuse_time_compare(const void *a, const void *b)
+{
+	uint32_t x = (*(Reuse_Slot * const *)a)->time, y = (*(Reuse_Slot * const *)b)->time;
+	
+	return (x > y) - (x < y);
+}
+
+/* reuse analyzer: close the current working-set window (windows without accesses are not counted) */
+void reuse_window_done()
+{
+	if (wsBlocks == 0){
+		return;
+	}
+	if (WS_WINDOWS == 0 || wsBlocks < WS_MIN){
+		WS_MIN = wsBlocks;
+	}
+	if (wsBlocks > WS_MAX){
+		WS_MAX = wsBlocks;
+	}
+	WS_SUM += wsBlocks;
+	WS_WINDOWS++;
+	wsBlocks = 0;
+}
+
+/************************************************************/
+/* reuse analyzer: forget every block and clear the stats                                            */ 
+/************************************************************/
+void reuse_reset()
+{
+	if (reuseTable != NULL){
+		memset(reuseTable, 0, reuseTableSize * sizeof(Reuse_Slot));
+		memset(reuseTree, 0, (reuseTreeSize + 1) * sizeof(uint32_t));
+	}
+	reuseNow = 0;
+	wsWindow = 0;
+	wsBlocks = 0;
+	memset(REUSE_HISTOGRAM, 0, sizeof(REUSE_HISTOGRAM));
+	REUSE_COLD = 0;
+	REUSE_ACCESSES = 0;
+	REUSE_BLOCKS = 0;
+	WS_WINDOWS = 0;
+	WS_MIN = 0;
+	WS_MAX = 0;
+	WS_SUM = 0;
+}
+
+/************************************************************/
+/* turn the reuse analyzer on (starting from nothing) or off                                       */ 
+/************************************************************/
+void set_reuse(int on, uint32_t window)
+{
+	if (window < 1){
+		printf("Invalid window (instructions >= 1)\n");
+		return;
+	}
+	free(reuseTable);
+	free(reuseTree);
+	reuseTable = NULL;
+	reuseTree = NULL;
+	REUSE_ON = (on != 0);
+	REUSE_WINDOW = window;
+	if (REUSE_ON){
+		reuseTableSize = REUSE_MIN_TABLE;
+		reuseTable = calloc(reuseTableSize, sizeof(Reuse_Slot));
+		reuseTreeSize = REUSE_MIN_TIMELINE;
+		reuseTree = calloc(reuseTreeSize + 1, sizeof(uint32_t));
+	}
+	reuse_reset();
+	wsWindow = INSTRUCTION_COUNT / REUSE_WINDOW;
+}
+
+/************************************************************/
+/* reuse analyzer: histogram with the hit rate a fully-associative LRU cache of each size */
+/* would get, then the working set per window                                                         */ 
+/************************************************************/
+void print_reuse()
+{
+	int b;
+	uint64_t hits = 0;
+	uint32_t blocks;
+	
+	if (!REUSE_ON){
+		printf("Reuse analyzer is off\n");
+		return;
+	}
+	printf("-------------------------------------\n");
+	printf("Reuse distance: %llu accesses, %u distinct %d-byte blocks (%u bytes), %llu cold\n", (unsigned long long)REUSE_ACCESSES,
+		REUSE_BLOCKS, WORD_PER_BLOCK * 4, REUSE_BLOCKS * WORD_PER_BLOCK * 4, (unsigned long long)REUSE_COLD);
+	printf("-------------------------------------\n");
+	printf("[Distance]\t\t[Accesses]\t[%%]\t[LRU cache]\t[Hit rate]\n");
+	for (b = 0; b < REUSE_BUCKETS && REUSE_ACCESSES != 0; b++){
+		if (REUSE_HISTOGRAM[b] == 0){
+			continue;
+		}
+		hits += REUSE_HISTOGRAM[b];
+		blocks = b < 32 ? 1u << b : 0xFFFFFFFF; //smallest cache that hits every distance up to here
+		if (b == 0){
+			printf("0\t\t\t");
+		}else if (b == 1){
+			printf("1\t\t\t");
+		}else if (b < REUSE_BUCKETS - 1){
+			printf("%u-%u\t\t", 1u << (b - 1), (1u << (b - 1)) * 2 - 1);
+		}else {
+			printf(">=%u\t\t", 1u << (b - 1));
+		}
+		printf("%llu\t\t%.2f\t%u blocks\t%.2f%%\n", (unsigned long long)REUSE_HISTOGRAM[b], 100.0 * REUSE_HISTOGRAM[b] / REUSE_ACCESSES,
+			blocks, 100.0 * hits / REUSE_ACCESSES);
+	}
+	if (WS_WINDOWS != 0){
+		printf("Working set per %u instructions: %u windows, min %u, avg %.1f, max %u blocks (max %u bytes)\n", REUSE_WINDOW, WS_WINDOWS,
+			WS_MIN, (double)WS_SUM / WS_WINDOWS, WS_MAX, WS_MAX * WORD_PER_BLOCK * 4);
+	}
+	if (wsBlocks != 0){
+		printf("Current window so far\t: %u blocks\n", wsBlocks);
+	}
+}
+
+/************************************************************/
+/* 3C classifier: first-touch bitmap and shadow cache for a demand access                */ 
+/************************************************************/
+void classify_access(uint32_t address)
+{
+	int i, lru = 0;
+	uint32_t blockAddress = CACHE_BLOCK_ADDRESS(address);
+	uint32_t bit = (blockAddress >> 4) & ((1 << (SEEN_PAGE_SHIFT - 4)) - 1);
+	uint8_t *page = SEEN_PAGES[blockAddress >> SEEN_PAGE_SHIFT];
+	
+	if (page == NULL){
+		page = calloc(SEEN_PAGE_BYTES, 1);
+		SEEN_PAGES[blockAddress >> SEEN_PAGE_SHIFT] = page;
+	}
+	missFirstTouch = !(page[bit >> 3] & (1 << (bit & 7)));
+	page[bit >> 3] |= 1 << (bit & 7);
+	
+	shadowClock++;
+	missShadowHit = FALSE;
+	for (i = 0; i < NUM_CACHE_BLOCKS; i++){
+		if (SHADOW_CACHE[i].valid && SHADOW_CACHE[i].blockAddress == blockAddress){
+			missShadowHit = TRUE;
+			SHADOW_CACHE[i].lastUse = shadowClock;
+			return;
+		}
+		if (!SHADOW_CACHE[lru].valid){
+			continue;
+		}
+		if (!SHADOW_CACHE[i].valid || SHADOW_CACHE[i].lastUse < SHADOW_CACHE[lru].lastUse){
+			lru = i;
+		}
+	}
+	SHADOW_CACHE[lru].valid = 1;
+	SHADOW_CACHE[lru].blockAddress = blockAddress;
+	SHADOW_CACHE[lru].lastUse = shadowClock;
+}
+
+/* 3C classifier: the access classify_access() just saw missed in L1Cache */
+void classify_miss(uint32_t pc, uint32_t address)
+{
+	int c = missFirstTouch ? MISS_COMPULSORY : (missShadowHit ? MISS_CONFLICT : MISS_CAPACITY);
+	
+	MISS_CLASS[c]++;
+	MISS_BY_REGION[miss_region(address)][c]++;
+	if (((pc - MEM_TEXT_BEGIN) >> 2) < MISS_BY_PC_SIZE){
+		MISS_BY_PC[(pc - MEM_TEXT_BEGIN) >> 2][c]++;
+	}
+}
+
+int miss_region(uint32_t address)
+{
+	if (address >= MEM_DATA_BEGIN && address < HEAP_BEGIN){
+		return REGION_DATA;
+	}
+	if (address >= HEAP_BEGIN && address < STACK_REGION_BEGIN){
+		return REGION_HEAP;
+	}
+	if (address >= STACK_REGION_BEGIN && address <= MEM_DATA_END){
+		return REGION_STACK;
+	}
+	return REGION_OTHER;
+}
+
+/************************************************************/
+/* 3C classifier: forget every block and clear the counts                                          */ 
+/************************************************************/
+void classify_reset()
+{
+	int i;
+	
+	if (SEEN_PAGES != NULL){
+		for (i = 0; i < SEEN_NUM_PAGES; i++){
+			free(SEEN_PAGES[i]);
+			SEEN_PAGES[i] = NULL;
+		}
+	}
+	if (MISS_BY_PC != NULL){
+		memset(MISS_BY_PC, 0, MISS_BY_PC_SIZE * sizeof(MISS_BY_PC[0]));
+	}
+	memset(SHADOW_CACHE, 0, sizeof(SHADOW_CACHE));
+	shadowClock = 0;
+	memset(MISS_CLASS, 0, sizeof(MISS_CLASS));
+	memset(MISS_BY_REGION, 0, sizeof(MISS_BY_REGION));
+}
+
+/************************************************************/
+/* 3C classifier on/off, counting starts from nothing                                                 */ 
+/************************************************************/
+void set_classify_misses(int on)
+{
+	if (SEEN_PAGES == NULL){
+		SEEN_PAGES = calloc(SEEN_NUM_PAGES, sizeof(uint8_t *));
+	}
+	classify_reset();
+	free(MISS_BY_PC);
+	MISS_BY_PC = NULL;
+	MISS_BY_PC_SIZE = 0;
+	CLASSIFY_MISSES = (on != 0);
+	if (CLASSIFY_MISSES){
+		MISS_BY_PC_SIZE = PROGRAM_SIZE;
+		MISS_BY_PC = calloc(MISS_BY_PC_SIZE, sizeof(MISS_BY_PC[0]));
+	}
+}
+
+/* most misses first */
+int miss_pc_compare(const void *a, const void *b)
+{
+	const uint32_t *x = MISS_BY_PC[*(const uint32_t *)a], *y = MISS_BY_PC[*(const uint32_t *)b];
+	uint32_t totalX = x[0] + x[1] + x[2], totalY = y[0] + y[1] + y[2];
+	
+	return (totalX < totalY) - (totalX > totalY);
+}
+
+/************************************************************/
+/* 3C classifier: totals, per data region and the PCs with the most misses           */ 
+/************************************************************/
+void print_miss_classes()
+{
+	const char *regions[NUM_REGIONS] = { "static data", "heap", "stack", "other" };
+	uint32_t i, n = 0, total = MISS_CLASS[0] + MISS_CLASS[1] + MISS_CLASS[2], *order;
+	uint32_t *m;
+	
+	printf("-------------------------------------\n");
+	printf("Miss classes (vs %d-block fully-associative LRU)\n", NUM_CACHE_BLOCKS);
+	if (total == 0){
+		printf("  no misses\n");
+		return;
+	}
+	printf("  compulsory\t\t: %u (%.2f%%)\n", MISS_CLASS[MISS_COMPULSORY], 100.0 * MISS_CLASS[MISS_COMPULSORY] / total);
+	printf("  capacity\t\t: %u (%.2f%%)\n", MISS_CLASS[MISS_CAPACITY], 100.0 * MISS_CLASS[MISS_CAPACITY] / total);
+	printf("  conflict\t\t: %u (%.2f%%)\n", MISS_CLASS[MISS_CONFLICT], 100.0 * MISS_CLASS[MISS_CONFLICT] / total);
+	printf("[Region]\t[Compulsory]\t[Capacity]\t[Conflict]\n");
+	for (i = 0; i < NUM_REGIONS; i++){
+		m = MISS_BY_REGION[i];
+		if (m[0] + m[1] + m[2] != 0){
+			printf("%s\t%u\t\t%u\t\t%u\n", regions[i], m[0], m[1], m[2]);
 		}
-	}else{
-		switch(EX_MEM.opcode){
-			case 0x4: //BEQ
-				stalling = 1;
-				break;
-			case 0x5: //BNE
-				stalling = 1;
-				break;
-			case 0x6: //BLEZ
-				stalling = 1;
-				break;
-			case 0x7: //BGTZ
-				stalling = 1;
-				break;
-			case 0x2: //J
-				stalling = 1;
-				break;
-			case 0x3: //JAL
-				stalling = 1;
-				break;
-			default:
-				stalling = 0;
-				break;
+	}
+	
+	order = malloc(MISS_BY_PC_SIZE * sizeof(uint32_t));
+	for (i = 0; i < MISS_BY_PC_SIZE; i++){
+		m = MISS_BY_PC[i];
+		if (m[0] + m[1] + m[2] != 0){
+			order[n++] = i;
 		}
 	}
+	qsort(order, n, sizeof(uint32_t), miss_pc_compare);
+	printf("[PC]\t\t[Compulsory]\t[Capacity]\t[Conflict]\t[Instruction]\n");
+	for (i = 0; i < n && i < MISS_TOP_PCS; i++){
+		m = MISS_BY_PC[order[i]];
+		printf("0x%08x\t%u\t\t%u\t\t%u\t\t", MEM_TEXT_BEGIN + (order[i] << 2), m[0], m[1], m[2]);
+		print_instruction(MEM_TEXT_BEGIN + (order[i] << 2));
+	}
+	free(order);
+}
+
+/************************************************************/
+/* scratchpad: the load/store is done in MEM's own cycle, straight to memory (or to a */
+/* DMA register)                                                                                         */ 
+/************************************************************/
+void spm_access(CPU_Pipeline_Reg *reg)
+{
+  uint32_t address = reg->ALUOutput;
   
-  if(cacheStalling != 0){
-    stalling = 1;
+  if(DMA_REGISTER(address)){
+    if(reg->memory_reference_load){
+      reg->LMD = dma_read(address);
+    } else {
+      dma_write(address, reg->B);
+    }
+    return;
+  }
+  if(reg->memory_reference_load){
+    reg->LMD = mem_read_32(address);
+    WATCH_ACCESS(reg->PC, address, reg->LMD, WATCH_READ);
+    if(reg->LLSC){
+      CORES[CORE_ID].llValid = 1;
+      CORES[CORE_ID].llAddress = address;
+    }
+    SPM_LOADS++;
+    return;
+  }
+  if(reg->LLSC){
+    reg->LMD = CORES[CORE_ID].llValid && CORES[CORE_ID].llAddress == address;
+    CORES[CORE_ID].llValid = 0;
+    if(!reg->LMD){
+      return;
+    }
+  }
+  if(CHECKING){
+    check_snapshot(address); //reference keeps the page as it was
+  }
+  mem_write_32(address, reg->B);
+  WATCH_ACCESS(reg->PC, address, reg->B, WATCH_WRITE);
+  SPM_STORES++;
+}
+
+/* DMA register as the guest reads it */
+uint32_t dma_read(uint32_t address)
+{
+  switch(address - DMA_BASE){
+    case DMA_SRC: return DMA.src;
+    case DMA_DST: return DMA.dst;
+    case DMA_LEN: return DMA.busy ? DMA.remaining : 0;
+    case DMA_CTRL: return DMA.busy;
+  }
+  return 0;
+}
+
+/************************************************************/
+/* DMA register write; a store to DMA_CTRL starts the copy                                   */ 
+/************************************************************/
+void dma_write(uint32_t address, uint32_t value)
+{
+  switch(address - DMA_BASE){
+    case DMA_SRC: DMA.src = value; break;
+    case DMA_DST: DMA.dst = value; break;
+    case DMA_LEN: DMA.length = value; break;
+    case DMA_CTRL:
+      if(DMA.busy || value == 0){
+        break; //one copy at a time
+      }
+      if((DMA.src & 3) || (DMA.dst & 3) || DMA.length == 0){
+        printf("\nDMA: ignoring copy of %u bytes 0x%08x -> 0x%08x (word-aligned addresses, length > 0)", DMA.length, DMA.src, DMA.dst);
+        break;
+      }
+      DMA.busy = 1;
+      DMA.from = DMA.src;
+      DMA.to = DMA.dst;
+      DMA.remaining = (DMA.length + 3) & ~3;
+      DMA.startCycle = CYCLE_COUNT;
+      DMA.nextCycle = CYCLE_COUNT + DMA_SETUP_CYCLES;
+      break;
+  }
+}
+
+/************************************************************/
+/* DMA engine, once a cycle: move the words that are due. Catches up by cycle count,  */
+/* so skipped stall cycles are not lost.                                                             */ 
+/************************************************************/
+void dma_tick()
+{
+  uint32_t value;
+  
+  while(DMA.busy && DMA.nextCycle <= CYCLE_COUNT){
+    //scratchpad words are not cached or buffered, main memory words may be
+    value = SPM_CONTAINS(DMA.from) ? mem_read_32(DMA.from) : mem_read_visible(DMA.from);
+    if(SPM_CONTAINS(DMA.to)){
+      mem_write_32(DMA.to, value);
+      if(CHECKING && REF_MEMORY[DMA.to >> REF_PAGE_SHIFT] != NULL){
+        ref_write(DMA.to, value, 4);
+      }
+    } else {
+      mem_write_visible(DMA.to, value);
+    }
+    DMA.from += 4;
+    DMA.to += 4;
+    DMA.remaining -= 4;
+    DMA.nextCycle += DMA_WORD_CYCLES;
+    DMA_WORDS++;
+    if(DMA.remaining == 0){
+      DMA.busy = 0;
+      DMA_TRANSFERS++;
+      DMA_BUSY_CYCLES += CYCLE_COUNT - DMA.startCycle;
+    }
   }
+}
+
+void spm_reset()
+{
+  memset(&DMA, 0, sizeof(DMA));
+  SPM_LOADS = 0;
+  SPM_STORES = 0;
+  DMA_TRANSFERS = 0;
+  DMA_WORDS = 0;
+  DMA_BUSY_CYCLES = 0;
+}
+
+/************************************************************/
+/* TLB lookup of the page holding address; a miss installs the entry over the set's    */
+/* LRU one (the walk or refill handler always succeeds). count = 0 for functional       */
+/* warming. Returns TRUE on a hit.                                                                     */ 
+/************************************************************/
+int tlb_lookup(int which, uint32_t address, int count)
+{
+  TLB *tlb = &TLBS[which];
+  uint32_t vpn = address >> TLB_PAGE_SHIFT;
+  int ways = TLB_WAYS[which];
+  int first = (vpn % (TLB_ENTRIES[which] / ways)) * ways; //first entry of the set
+  int i, lru = first;
   
-	if(!stalling){
-		ID_EX = IF_ID;
-		memset(&IF_ID, 0, sizeof(IF_ID)); //Clear IF_ID
-		ID_EX.registerRs = rs;
-		ID_EX.registerRt = rt;
-		ID_EX.registerRd = rd;
-		ID_EX.opcode = opcode;
-		ID_EX.function = function;
-		//Data forwarding?
-		if(!ENABLE_FORWARDING){
-			ID_EX.A = NEXT_STATE.REGS[ID_EX.registerRs];
-			ID_EX.B = NEXT_STATE.REGS[ID_EX.registerRt];
-		}else{
-			if(FORWARD_A == 01){
-				//RS from MEM stage
-				ID_EX.A = MEM_WB.LMD;
-			}else if(FORWARD_A == 10){
-				//RS from EX stage
-				ID_EX.A = EX_MEM.ALUOutput;
-			}
-			
-			if(FORWARD_B == 01){
-				//RT from MEM stage
-				ID_EX.B = MEM_WB.LMD;
-			}else if(FORWARD_B == 10){
-				//RT from EX stage
-				ID_EX.B = EX_MEM.ALUOutput;
-			}
-			//Clear the flags
-			FORWARD_A = 00;
-			FORWARD_B = 00;
+  tlb->clock++;
+  i = tag_match(&tlb->vpns.tags[first], &tlb->vpns.valid[first], ways, vpn);
+  if(i >= 0){
+    tlb->lastUse[first + i] = tlb->clock;
+    if(count){
+      tlb->hits++;
+    }
+    return TRUE;
+  }
+  if(count){
+    tlb->misses++;
+  }
+  for(i = first; i < first + ways; i++){
+    if(!tlb->vpns.valid[i]){
+      lru = i; //first free way
+      break;
+    }
+    if(tlb->lastUse[i] < tlb->lastUse[lru]){
+      lru = i;
+    }
+  }
+  tlb->vpns.tags[lru] = vpn;
+  tlb->vpns.valid[lru] = 0xFFFFFFFF;
+  tlb->lastUse[lru] = tlb->clock;
+  return FALSE;
+}
+
+/************************************************************/
+/* may IF fetch this cycle? An I-TLB miss holds fetch until the refill is done. Nothing  */
+/* younger has been fetched, so a software refill has nothing to flush here              */ 
+/************************************************************/
+int itlb_ready()
+{
+  uint32_t page = (NEXT_STATE.PC >> TLB_PAGE_SHIFT) + 1;
+  
+  if(MMU_MODE == MMU_OFF){
+    return TRUE;
+  }
+  if(itlbWalkPage != 0){
+    if(CYCLE_COUNT < itlbReadyCycle){
+      return FALSE;
+    }
+    if(page == itlbWalkPage){
+      itlbWalkPage = 0;
+      return TRUE; //the refill just finished
+    }
+    itlbWalkPage = 0; //fetch was redirected meanwhile
+  }
+  if(tlb_lookup(ITLB, NEXT_STATE.PC, TRUE)){
+    return TRUE;
+  }
+  itlbWalkPage = page;
+  itlbReadyCycle = CYCLE_COUNT + tlb_refill(ITLB, NEXT_STATE.PC);
+  return FALSE;
+}
+
+/************************************************************/
+/* refill the TLB entry for address from the page table, returns the cycles it takes      */ 
+/************************************************************/
+uint32_t tlb_refill(int which, uint32_t address)
+{
+  uint32_t vpn = address >> TLB_PAGE_SHIFT;
+  uint32_t cycles = TLB_REFILL_CYCLES;
+  
+  cycles += pte_read(which, PTE_ROOT_ADDRESS(vpn));
+  cycles += pte_read(which, PTE_LEAF_ADDRESS(vpn));
+  if(MMU_MODE == MMU_SOFTWARE_REFILL){
+    cycles += TLB_TRAP_ENTRY + TLB_TRAP_EXIT;
+    TLBS[which].traps++;
+  }
+  TLBS[which].missCycles += cycles;
+  return cycles;
+}
+
+/************************************************************/
+/* read one page table entry through the L1, returns its latency. A missing block is       */
+/* brought in as for a load; one in the victim buffer is read where it is                   */ 
+/************************************************************/
+uint32_t pte_read(int which, uint32_t address)
+{
+  int i;
+  uint32_t cycles = 1;
+  uint32_t blockIndex = CACHE_INDEX(address);
+  uint32_t blockAddress = CACHE_BLOCK_ADDRESS(address);
+  CacheBlock *block = &L1Cache.blocks[blockIndex];
+  
+  TLBS[which].pteReads++;
+  bus_lock();
+  if(block->valid && block->tag == CACHE_TAG(address)){
+    bus_unlock();
+    return cycles;
+  }
+  if(victim_lookup(blockAddress) >= 0){
+    bus_unlock();
+    return VICTIM_HIT_PENALTY;
+  }
+  TLBS[which].pteMisses++;
+  cycles = CACHE_MISS_PENALTY;
+  i = prefetch_in_flight(blockAddress);
+  if(i >= 0){
+    prefetchQueue[i].valid = 0; //would install a second copy
+  }
+  victim_insert(blockIndex);
+  block->state = snoop(BUS_READ, blockAddress) ? MESI_SHARED : MESI_EXCLUSIVE;
+  CORES[CORE_ID].busReads++;
+  for(i = 0; i < WORD_PER_BLOCK; i++){
+    block->words[i] = mem_read_32(blockAddress + (i * 4));
+  }
+  store_buffer_forward(blockAddress, block->words);
+  if(block->valid && block->prefetched){
+    prefetch_useless++;
+  }
+  block->valid = 1;
+  block->prefetched = 0;
+  block->tag = CACHE_TAG(address);
+  pollutedTag[blockIndex] = 0;
+  bus_unlock();
+  return cycles;
+}
+
+/************************************************************/
+/* software refill of a D-TLB miss: the instructions behind the faulting one are flushed */
+/* and fetched again, from the oldest of them, once the handler returns                   */ 
+/************************************************************/
+void tlb_trap()
+{
+  CPU_Pipeline_Reg *younger[4] = { &ID_EX, &ID_EX_2, &IF_ID, &IF_ID_2 }; //oldest first
+  int i;
+  
+  for(i = 0; i < 4; i++){
+    if(younger[i]->valid){
+      NEXT_STATE.PC = younger[i]->PC;
+      delaySlotPending = FALSE; //a flushed branch resolves again
+      break;
+    }
+  }
+  LOG(LOG_PIPELINE, LOG_DEBUG, "0x%08x D-TLB refill trap, fetch continues at 0x%08x", memory_slot()->PC, NEXT_STATE.PC);
+  flush();
+}
+
+void tlb_reset()
+{
+  memset(TLBS, 0, sizeof(TLBS));
+  tlbWalking = FALSE;
+  itlbReadyCycle = 0;
+  itlbWalkPage = 0;
+}
+
+void print_tlb_stats()
+{
+  int i;
+  uint32_t lookups;
+  
+  printf("-------------------------------------\n");
+  if(MMU_MODE == MMU_HARDWARE_WALK){
+    printf("MMU\t\t\t: hardware page walk, %u walker cycles + page table reads per miss\n", TLB_REFILL_CYCLES);
+  } else {
+    printf("MMU\t\t\t: software refill, %u + %u trap + %u handler cycles + page table reads per miss\n", TLB_TRAP_ENTRY, TLB_TRAP_EXIT, TLB_REFILL_CYCLES);
+  }
+  for(i = ITLB; i <= DTLB; i++){
+    lookups = TLBS[i].hits + TLBS[i].misses;
+    printf("%s (%d, %d-way)\t: %u hits, %u misses (%.2f%%), %u miss cycles\n", i == ITLB ? "I-TLB" : "D-TLB",
+      TLB_ENTRIES[i], TLB_WAYS[i], TLBS[i].hits, TLBS[i].misses, lookups ? 100.0 * TLBS[i].misses / lookups : 0.0,
+      TLBS[i].missCycles);
+    printf("  page table reads\t: %u, %u L1 misses%s", TLBS[i].pteReads, TLBS[i].pteMisses, MMU_MODE == MMU_SOFTWARE_REFILL ? "" : "\n");
+    if(MMU_MODE == MMU_SOFTWARE_REFILL){
+      printf(", %u traps\n", TLBS[i].traps);
+    }
+  }
+}
+
+/************************************************************/
+/* queue one log record, waits (yielding) only if the ring is full                              */
+/************************************************************/
+void log_write(int category, const char *format, const uint32_t *args)
+{
+  Log_Record *ring, *record;
+  uint32_t position, sequence;
+
+  //announce ourselves before looking at the ring, log_stop() waits for us to leave
+  atomic_fetch_add(&logWriters, 1);
+  ring = atomic_load(&logRing);
+  if(ring == NULL){
+    atomic_fetch_sub(&logWriters, 1);
+    return; //sink not running
+  }
+  position = atomic_load_explicit(&logHead, memory_order_relaxed);
+  while(1){
+    record = &ring[position & (LOG_RING_SIZE - 1)];
+    sequence = atomic_load_explicit(&record->sequence, memory_order_acquire);
+    if(sequence == position){
+      //slot is free, claim it
+      if(atomic_compare_exchange_weak_explicit(&logHead, &position, position + 1, memory_order_relaxed, memory_order_relaxed)){
+        break;
+      }
+    } else if((int32_t)(sequence - position) < 0){
+      //drain thread hasn't freed it yet
+      atomic_fetch_add_explicit(&LOG_FULL_WAITS, 1, memory_order_relaxed);
+      sched_yield();
+      position = atomic_load_explicit(&logHead, memory_order_relaxed);
+    } else {
+      //another producer took it
+      position = atomic_load_explicit(&logHead, memory_order_relaxed);
+    }
+  }
+  record->format = format;
+  record->cycle = CYCLE_COUNT;
+  record->core = CORE_ID;
+  record->category = category;
+  memcpy(record->args, args, sizeof(record->args));
+  atomic_store_explicit(&record->sequence, position + 1, memory_order_release);
+  atomic_fetch_add_explicit(&LOG_RECORDS, 1, memory_order_relaxed);
+  atomic_fetch_sub_explicit(&logWriters, 1, memory_order_release);
+}
+
+/************************************************************/
+/* format and write every record that is ready, returns how many                                */
+/************************************************************/
+int log_drain(Log_Record *ring)
+{
+  Log_Record *record;
+  int count = 0;
+
+  while(1){
+    record = &ring[logTail & (LOG_RING_SIZE - 1)];
+    if(atomic_load_explicit(&record->sequence, memory_order_acquire) != logTail + 1){
+      return count; //next one not written yet
+    }
+    fprintf(logOut, "%10u core%u %-8s ", record->cycle, record->core, LOG_CATEGORY_NAMES[record->category]);
+    fprintf(logOut, record->format, record->args[0], record->args[1], record->args[2], record->args[3]);
+    fputc('\n', logOut);
+    atomic_store_explicit(&record->sequence, logTail + LOG_RING_SIZE, memory_order_release);
+    logTail++;
+    count++;
+  }
+}
+
+/************************************************************/
+/* drain thread: runs until log_stop() and the ring is empty                                     */
+/************************************************************/
+void *log_main(void *arg)
+{
+  Log_Record *ring = arg; //log_stop() clears logRing before it joins
+  struct timespec nap = { 0, LOG_DRAIN_SLEEP_NS };
+
+  while(1){
+    if(log_drain(ring) == 0){
+      if(atomic_load(&logStop)){
+        log_drain(ring); //anything queued just before the stop
+        break;
+      }
+      fflush(logOut);
+      nanosleep(&nap, NULL);
+    }
+  }
+  fflush(logOut);
+  return NULL;
+}
+
+/************************************************************/
+/* open LOG_FILE and start the drain thread, 0 on success                                          */
+/************************************************************/
+int log_start()
+{
+  Log_Record *ring;
+  uint32_t i;
+
+  if(atomic_load(&logRing) != NULL){
+    return 0;
+  }
+  logOut = fopen(LOG_FILE, "w");
+  if(logOut == NULL){
+    printf("Could not open log file %s\n", LOG_FILE);
+    return -1;
+  }
+  ring = malloc(LOG_RING_SIZE * sizeof(Log_Record));
+  for(i = 0; i < LOG_RING_SIZE; i++){
+    atomic_init(&ring[i].sequence, i);
+  }
+  atomic_store(&logHead, 0);
+  logTail = 0;
+  atomic_store(&logStop, FALSE);
+  pthread_create(&logThread, NULL, log_main, ring);
+  atomic_store(&logRing, ring); //publish last, producers may start right away
+  return 0;
+}
+
+/************************************************************/
+/* flush everything queued, stop the drain thread and close the file. Safe while cores run:   */
+/* the ring is freed only after every producer that saw it has left log_write()               */
+/************************************************************/
+void log_stop()
+{
+  Log_Record *ring = atomic_exchange(&logRing, NULL); //new producers stop queueing
+
+  if(ring == NULL){
+    return;
+  }
+  //producers already past the check finish their record, the drain thread is still running
+  while(atomic_load(&logWriters) != 0){
+    sched_yield();
+  }
+  atomic_store(&logStop, TRUE);
+  pthread_join(logThread, NULL);
+  fclose(logOut);
+  logOut = NULL;
+  free(ring);
+}
+
+/***************************************************************/
+/* Set the runtime log level of a category ("all" for every one)                     */
+/***************************************************************/
+void configure_logging(const char *category, int level) {
+	int i, on = FALSE;
+
+	if (LOG_MAX_LEVEL == LOG_OFF){
+		printf("Logging is compiled out, rebuild without -DLOG_MAX_LEVEL=0\n");
+		return;
+	}
+	if (level < LOG_OFF || level > LOG_MAX_LEVEL){
+		printf("Invalid level (0 = off, 1 = info, 2 = debug, 3 = trace; this build goes up to %d)\n", LOG_MAX_LEVEL);
+		return;
+	}
+	for (i = 0; i < LOG_CATEGORIES; i++){
+		if (strcmp(category, "all") == 0 || strcmp(category, LOG_CATEGORY_NAMES[i]) == 0){
+			break;
 		}
-		
-		
+	}
+	if (i == LOG_CATEGORIES){
+		printf("Unknown category %s (cache, pipeline, loader or all)\n", category);
+		return;
+	}
+	for (i = 0; i < LOG_CATEGORIES; i++){
+		if (strcmp(category, "all") == 0 || strcmp(category, LOG_CATEGORY_NAMES[i]) == 0){
+			LOG_LEVELS[i] = level;
+		}
+		on |= LOG_LEVELS[i] != LOG_OFF;
+	}
+	if (on && log_start() != 0){
+		memset(LOG_LEVELS, 0, sizeof(LOG_LEVELS));
+		return;
+	}
+	if (!on){
+		log_stop();
+	}
+}
+
+/***************************************************************/
+/* Send the log somewhere else (restarts the sink if it is running)                   */
+/***************************************************************/
+void set_log_file(const char *path) {
+	int running = logRing != NULL;
+
+	log_stop();
+	snprintf(LOG_FILE, sizeof(LOG_FILE), "%s", path);
+	if (running && log_start() != 0){
+		memset(LOG_LEVELS, 0, sizeof(LOG_LEVELS));
+	}
+}
+
+/************************************************************/
+/* digest: first write to a page since its hash was taken                                            */
+/************************************************************/
+void digest_touch(uint32_t page)
+{
+  //cores can store at the same time, so claim the bit and the list slot atomically
+  if(__atomic_fetch_or(&DIGEST_STALE[page >> 6], DIGEST_BIT(page), __ATOMIC_RELAXED) & DIGEST_BIT(page)){
+    return;
+  }
+  digestStaleList[__atomic_fetch_add(&digestStaleCount, 1, __ATOMIC_RELAXED)] = page;
+  if(!(__atomic_fetch_or(&DIGEST_TOUCHED[page >> 6], DIGEST_BIT(page), __ATOMIC_RELAXED) & DIGEST_BIT(page))){
+    digestTouchedList[__atomic_fetch_add(&digestTouchedCount, 1, __ATOMIC_RELAXED)] = page;
+  }
+}
+
+/************************************************************/
+/* digest: memory was cleared, forget every page                                                         */
+/************************************************************/
+void digest_reset()
+{
+  uint32_t i, page;
+
+  for(i = 0; i < digestTouchedCount; i++){
+    page = digestTouchedList[i];
+    DIGEST_STALE[page >> 6] &= ~DIGEST_BIT(page);
+    DIGEST_TOUCHED[page >> 6] &= ~DIGEST_BIT(page);
+    digestShare[page] = 0;
+  }
+  digestStaleCount = 0;
+  digestTouchedCount = 0;
+  digestMemory = 0;
+}
+
+/* 64-bit finalizer (splitmix64) */
+uint64_t digest_mix(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+/************************************************************/
+/* digest: one page's share, 0 if it is all zeros. visible = read through the store buffers  */
+/************************************************************/
+uint64_t digest_page(uint32_t page, int visible)
+{
+  uint32_t address = page << DIGEST_PAGE_SHIFT, low, high;
+  uint64_t lane, any = 0, hash = page;
+  const uint8_t *mem = NULL;
+  int i;
+
+  for(i = 0; i < NUM_MEM_REGION; i++){
+    if(address >= MEM_REGIONS[i].begin && address <= MEM_REGIONS[i].end){
+      mem = MEM_REGIONS[i].mem + (address - MEM_REGIONS[i].begin);
+    }
+  }
+  if(mem == NULL){
+    return 0; //outside every region, reads as zero
+  }
+  for(i = 0; i < DIGEST_PAGE_WORDS; i++, mem += 8, address += 8){
+    if(visible){
+      low = mem_read_visible(address);
+      high = mem_read_visible(address + 4);
+    } else {
+      low = mem[0] | (mem[1] << 8) | (mem[2] << 16) | ((uint32_t)mem[3] << 24);
+      high = mem[4] | (mem[5] << 8) | (mem[6] << 16) | ((uint32_t)mem[7] << 24);
+    }
+    lane = ((uint64_t)high << 32) | low;
+    any |= lane;
+    hash = (hash ^ (lane * 0x9E3779B97F4A7C15ULL)) * 0xFF51AFD7ED558CCDULL;
+    hash ^= hash >> 29;
+  }
+  return any ? digest_mix(hash) : 0;
+}
+
+/************************************************************/
+/* digest of every core's GPRs, HI and LO. Not the PC: it is the fetch address, which  */
+/* runs ahead of the exit by a different amount in each core model                                */
+/************************************************************/
+uint64_t digest_registers()
+{
+  uint64_t hash = CORE_COUNT;
+  CPU_State *state;
+  int i, j;
+
+  for(i = 0; i < CORE_COUNT; i++){
+    state = CORES[i].state;
+    for(j = 0; j < MIPS_REGS; j++){
+      hash = digest_mix(hash ^ state->REGS[j]);
+    }
+    hash = digest_mix(hash ^ state->HI);
+    hash = digest_mix(hash ^ state->LO);
+  }
+  return hash;
+}
+
+/************************************************************/
+/* digest of memory: rehash the stale pages, then patch in pages with buffered stores       */
+/************************************************************/
+uint64_t digest_memory()
+{
+  uint32_t i, page, buffered[MAX_CORES * MAX_STORE_BUFFER], count = 0;
+  uint64_t share, total;
+  StoreBuffer *sb;
+  int c, j;
+
+  for(i = 0; i < digestStaleCount; i++){
+    page = digestStaleList[i];
+    share = digest_page(page, FALSE);
+    digestMemory += share - digestShare[page];
+    digestShare[page] = share;
+    DIGEST_STALE[page >> 6] &= ~DIGEST_BIT(page);
+  }
+  digestStaleCount = 0;
 
-		//Sign extension for immediate value
-		if(ID_EX.IR & 0x00008000){
-			//Negative
-			uint32_t negative = 0xFFFF0000;
-			ID_EX.imm = immediate | negative;
-		}else{
-			//Positive
-			ID_EX.imm = immediate;
-		}
-	}
+  total = digestMemory;
+  for(c = 0; c < CORE_COUNT; c++){
+    sb = CORES[c].storeBuffer;
+    for(j = 0; j < sb->count; j++){
+      page = sb->entries[(sb->head + j) % MAX_STORE_BUFFER].blockAddress >> DIGEST_PAGE_SHIFT;
+      for(i = 0; i < count && buffered[i] != page; i++);
+      if(i == count){
+        buffered[count++] = page;
+        total += digest_page(page, TRUE) - digestShare[page];
+      }
+    }
+  }
+  return total;
+}
+
+int digest_page_compare(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
 }
 
 /************************************************************/
-/* instruction fetch (IF) pipeline stage:                                                              */ 
+/* print the digest, and with pages the share of every written page that is not all zeros   */
 /************************************************************/
-void IF()
+void print_digest(int pages)
 {
-	if(!stalling){
-		IF_ID.IR = mem_read_32(CURRENT_STATE.PC);
-		IF_ID.PC = CURRENT_STATE.PC;
-		NEXT_STATE.PC += 4;
-	}
-	
+  uint64_t memory = digest_memory(), registers = digest_registers(), share;
+  uint32_t *list, i;
+
+  printf("State digest\t\t: %016llx (registers %016llx, memory %016llx, %u pages written)\n",
+    (unsigned long long)digest_mix(registers ^ digest_mix(memory)), (unsigned long long)registers, (unsigned long long)memory, digestTouchedCount);
+  if(!pages){
+    return;
+  }
+  list = malloc((digestTouchedCount + 1) * sizeof(uint32_t));
+  memcpy(list, digestTouchedList, digestTouchedCount * sizeof(uint32_t));
+  qsort(list, digestTouchedCount, sizeof(uint32_t), digest_page_compare);
+  for(i = 0; i < digestTouchedCount; i++){
+    share = digest_page(list[i], TRUE);
+    if(share != 0){
+      printf("0x%08x\t%016llx\n", list[i] << DIGEST_PAGE_SHIFT, (unsigned long long)share);
+    }
+  }
+  free(list);
 }
 
+#ifdef HOST_PROFILE
+/************************************************************/
+/* host profiler: forget what this core has measured                                                  */
+/************************************************************/
+void host_profile_reset()
+{
+  memset(HOST_TICKS, 0, sizeof(HOST_TICKS));
+  memset(HOST_CALLS, 0, sizeof(HOST_CALLS));
+}
 
 /************************************************************/
-/* Initialize Memory                                                                                                    */ 
+/* ns per host tick, the TSC rate is measured against the clock once                           */
 /************************************************************/
-void initialize() { 
-	init_memory();
-	CURRENT_STATE.PC = MEM_TEXT_BEGIN;
-	NEXT_STATE = CURRENT_STATE;
-	RUN_FLAG = TRUE;
+double host_ns_per_tick()
+{
+#ifdef HOST_TSC
+  struct timespec begin, end;
+  uint64_t ticks;
+  int64_t ns;
+
+  if(hostNsPerTick == 0){
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    ticks = __rdtsc();
+    do {
+      clock_gettime(CLOCK_MONOTONIC, &end);
+      ns = (int64_t)(end.tv_sec - begin.tv_sec) * 1000000000 + (end.tv_nsec - begin.tv_nsec);
+    } while(ns < HOST_CALIBRATE_NS);
+    hostNsPerTick = (double)ns / (__rdtsc() - ticks);
+  }
+  return hostNsPerTick;
+#else
+  return 1.0;
+#endif
+}
+
+void print_host_profile()
+{
+  int i;
+  double ns, scale = host_ns_per_tick();
+  double total = HOST_TICKS[HOST_CYCLE] * scale;
+
+  printf("-------------------------------------\n");
+  printf("Host profile (inclusive, this core, %.3f ns per tick)\n", scale);
+  printf("%-14s %12s %12s %10s %8s %12s\n", "section", "calls", "ms", "ns/cycle", "%cycle", "sim MIPS");
+  for(i = 0; i < HOST_SECTIONS; i++){
+    ns = HOST_TICKS[i] * scale;
+    printf("%-14s %12llu %12.3f %10.2f %7.1f%% %12.2f\n", HOST_SECTION_NAMES[i], (unsigned long long)HOST_CALLS[i], ns / 1e6,
+      CYCLE_COUNT ? ns / CYCLE_COUNT : 0.0, total > 0 ? 100.0 * ns / total : 0.0, ns > 0 ? INSTRUCTION_COUNT * 1e3 / ns : 0.0);
+  }
+}
+#endif
+
+void print_log_stats()
+{
+  int i;
+
+  printf("-------------------------------------\n");
+  printf("Log\t\t\t: %s,", LOG_FILE);
+  for(i = 0; i < LOG_CATEGORIES; i++){
+    printf(" %s %d", LOG_CATEGORY_NAMES[i], LOG_LEVELS[i]);
+  }
+  printf("\n");
+  printf("Records queued\t\t: %u (waited on a full ring %u times)\n", atomic_load(&LOG_RECORDS), atomic_load(&LOG_FULL_WAITS));
 }
 
 /************************************************************/
@@ -1254,6 +5482,12 @@ void print_instruction(uint32_t addr){
 			case 0x2B:
 				printf("SW $r%u, 0x%x($r%u)\n", rt, immediate, rs);
 				break;
+			case 0x30:
+				printf("LL $r%u, 0x%x($r%u)\n", rt, immediate, rs);
+				break;
+			case 0x38:
+				printf("SC $r%u, 0x%x($r%u)\n", rt, immediate, rs);
+				break;
 			default:
 				printf("Instruction is not implemented!\n");
 				break;
@@ -1301,48 +5535,608 @@ void show_pipeline(){
 	printf("\nstalling: %d\n", stalling);
   printf("\nCache Stalling: %d", cacheStalling);
 	printf("\nENABLE_FORWARDING: %d", ENABLE_FORWARDING);
+	printf("\nISSUE_WIDTH: %d", ISSUE_WIDTH);
+	if(OOO_MODE){
+		int i;
+		printf("\nOut-of-order core, ROB %d/%d, LSQ %d/%d", robCount, OOO_ROB_SIZE, lsqUsed, OOO_LSQ_SIZE);
+		for(i = 0; i < robCount; i++){
+			ROB_Entry *e = &ROB[(robHead + i) % OOO_ROB_SIZE];
+			printf("\n  [%u] PC %x IR %08x %s", e->seq, e->PC, e->IR, ooo_done(e) ? "done" : (e->issued ? "executing" : "waiting"));
+		}
+	}
+	if(ISSUE_WIDTH == 2){
+		printf("\nIF_ID_2.IR: %x", IF_ID_2.IR);
+		printf("\nIF_ID_2.PC: %x", IF_ID_2.PC);
+		printf("\nID_EX_2.IR: %x", ID_EX_2.IR);
+		printf("\nID_EX_2.A: %x", ID_EX_2.A);
+		printf("\nID_EX_2.B: %x", ID_EX_2.B);
+		printf("\nEX_MEM_2.IR: %x", EX_MEM_2.IR);
+		printf("\nEX_MEM_2.ALUOutput: %x", EX_MEM_2.ALUOutput);
+		printf("\nMEM_WB_2.IR: %x", MEM_WB_2.IR);
+		printf("\nMEM_WB_2.ALUOutput: %x", MEM_WB_2.ALUOutput);
+		printf("\nMEM_WB_2.LMD: %x", MEM_WB_2.LMD);
+	}
   
   printf("\nInstruction Count: %d", INSTRUCTION_COUNT);
 	
 }
 
-/***************************************************************/
-/* main                                                                                                                                   */
-/***************************************************************/
-int main(int argc, char *argv[]) {                              
-	printf("\n**************************\n");
-	printf("Welcome to MU-MIPS SIM...\n");
-	printf("**************************\n\n");
+/************************************************************/
+/* Run the SYSCALL service in $v0 with $a0 as argument. Returns the new $v0 and sets  */
+/* *halt for exit/exit2.                                                                                    */ 
+/************************************************************/
+uint32_t syscall_emulate(uint32_t service, uint32_t argument, int *halt)
+{
+	char text[32];
+	uint32_t result = service, i;
+	int n, c;
+	
+	*halt = FALSE;
+	bus_lock(); //cores share the output buffer, the input and the heap
+	switch(service){
+		case SYS_PRINT_INT:
+			n = snprintf(text, sizeof(text), "%d", (int32_t)argument);
+			guest_output(text, n);
+			break;
+		case SYS_PRINT_STRING:
+			for(i = 0; i < MAX_GUEST_STRING; i++){
+				text[0] = syscall_read_byte(argument + i);
+				if(text[0] == '\0'){
+					break;
+				}
+				guest_output(text, 1);
+			}
+			break;
+		case SYS_READ_INT:
+			result = guest_input_line(text, sizeof(text)) ? (uint32_t)strtol(text, NULL, 0) : 0;
+			break;
+		case SYS_SBRK:
+			result = HEAP_END;
+			HEAP_END += (argument + 3) & ~3; //keep the break word aligned
+			break;
+		case SYS_EXIT:
+			*halt = TRUE;
+			break;
+		case SYS_PRINT_CHAR:
+			text[0] = argument & 0xFF;
+			guest_output(text, 1);
+			break;
+		case SYS_READ_CHAR:
+			guest_output_flush();
+			c = getchar();
+			result = (c == EOF) ? 0xFFFFFFFF : (uint32_t)c;
+			break;
+		case SYS_EXIT2:
+			*halt = TRUE;
+			EXIT_CODE = argument;
+			break;
+		default:
+			printf("Unknown SYSCALL %u, ignored\n", service);
+			break;
+	}
+	if(*halt){
+		guest_output_flush();
+	}
+	bus_unlock();
+	return result;
+}
+
+/* byte of guest memory as the program sees it (stores still in a store buffer included) */
+uint8_t syscall_read_byte(uint32_t address)
+{
+	return (mem_read_visible(address & ~3) >> (8 * (address & 3))) & 0xFF;
+}
+
+/************************************************************/
+/* guest output: collect it, the host only sees full buffers                                      */ 
+/************************************************************/
+void guest_output(const char *text, int length)
+{
+	int n;
 	
-	if (argc < 2) {
-		printf("Error: You should provide input file.\nUsage: %s <input program> \n\n",  argv[0]);
-		exit(1);
+	while(length > 0){
+		if(guestOutputCount == GUEST_OUTPUT_SIZE){
+			guest_output_flush();
+		}
+		n = GUEST_OUTPUT_SIZE - guestOutputCount;
+		if(n > length){
+			n = length;
+		}
+		memcpy(&GUEST_OUTPUT[guestOutputCount], text, n);
+		guestOutputCount += n;
+		text += n;
+		length -= n;
 	}
+}
 
-	strcpy(prog_file, argv[1]);
-  printf("\nAfter copy");
-	initialize();
-  printf("\nAfter initialize");
-	load_program();
-  printf("\nAfter loadProgram");
-	help();
-	while (1){
-		handle_command();
+void guest_output_flush()
+{
+	if(guestOutputCount != 0){
+		fwrite(GUEST_OUTPUT, 1, guestOutputCount, stdout);
+		guestOutputCount = 0;
 	}
-	return 0;
+	fflush(stdout);
+}
+
+/* read a line of guest input, pending output goes first so prompts show up */
+int guest_input_line(char *line, int size)
+{
+	guest_output_flush();
+	return fgets(line, size, stdin) != NULL;
+}
+
+/************************************************************/
+/* fresh heap and exit code for a new run                                                            */ 
+/************************************************************/
+void syscall_reset()
+{
+	HEAP_END = HEAP_BEGIN;
+	EXIT_CODE = 0;
+	guestOutputCount = 0;
 }
 
 void flush(void){
-	printf("flushing\n");
-	memset(&IF_ID, 0, sizeof(EX_MEM));
-	memset(&ID_EX, 0, sizeof(ID_EX));
+	LOG(LOG_PIPELINE, LOG_DEBUG, "flush, fetch continues at 0x%08x", NEXT_STATE.PC);
+	latch_clear(&IF_ID);
+	latch_clear(&ID_EX);
+	latch_clear(&IF_ID_2);
+	latch_clear(&ID_EX_2);
+}
+
+/************************************************************/
+/* store buffer: entry a store to this block can coalesce into, -1 if none                */ 
+/************************************************************/
+int store_buffer_find(StoreBuffer *sb, uint32_t blockAddress){
+  int i, slot;
+  for(i = 0; i < sb->count; i++){
+    slot = (sb->head + i) % MAX_STORE_BUFFER;
+    if(i == 0 && sb->drainDone != 0){
+      continue; //already on its way to memory
+    }
+    if(sb->entries[slot].blockAddress == blockAddress){
+      return slot;
+    }
+  }
+  return -1;
+}
+
+/************************************************************/
+/* store buffer: TRUE if a store to this block has nowhere to go                            */ 
+/************************************************************/
+int store_buffer_blocked(uint32_t blockAddress){
+  return storeBuffer.count >= STORE_BUFFER_SIZE && store_buffer_find(&storeBuffer, blockAddress) < 0;
+}
+
+/************************************************************/
+/* store buffer: queue a store, coalescing it with a pending one to the same block   */ 
+/************************************************************/
+void store_buffer_insert(uint32_t address, uint32_t value){
+  int slot;
+  uint32_t blockAddress = CACHE_BLOCK_ADDRESS(address);
+  
+  store_buffer_stores++;
+  slot = store_buffer_find(&storeBuffer, blockAddress);
+  if(slot >= 0){
+    store_buffer_coalesced++;
+  } else {
+    if(storeBuffer.count >= STORE_BUFFER_SIZE){
+      //MEM() waits for a free entry, this only happens if the drain was slower than it said
+      store_buffer_drain(&storeBuffer, 1);
+    }
+    slot = (storeBuffer.head + storeBuffer.count) % MAX_STORE_BUFFER;
+    storeBuffer.entries[slot].blockAddress = blockAddress;
+    storeBuffer.entries[slot].mask = 0;
+    storeBuffer.count++;
+  }
+  storeBuffer.entries[slot].words[CACHE_WORD_OFFSET(address)] = value;
+  storeBuffer.entries[slot].mask |= 1 << CACHE_WORD_OFFSET(address);
+}
+
+/************************************************************/
+/* store buffer: one cycle of background draining, called from MEM()                    */ 
+/************************************************************/
+void store_buffer_tick(){
+  store_buffer_occupancy += storeBuffer.count;
+  if(storeBuffer.count == 0){
+    return;
+  }
+  bus_lock();
+  if(storeBuffer.drainDone != 0 && storeBuffer.drainDone <= CYCLE_COUNT){
+    store_buffer_drain(&storeBuffer, 1);
+  }
+  if(storeBuffer.count != 0 && storeBuffer.drainDone == 0){
+    storeBuffer.drainDone = CYCLE_COUNT + STORE_DRAIN_CYCLES;
+  }
+  bus_unlock();
 }
 
-void writeBufferToMemory(uint32_t blockAddress){
+/************************************************************/
+/* store buffer: write the n oldest entries to memory now                                          */ 
+/************************************************************/
+void store_buffer_drain(StoreBuffer *sb, int n){
   int i;
-  mem_write_32(blockAddress, writeBuffer.words[0]);
-  mem_write_32((blockAddress+0x1), writeBuffer.words[1]);
-  mem_write_32((blockAddress+0x2), writeBuffer.words[2]);
-  mem_write_32((blockAddress+0x3), writeBuffer.words[3]);
+  StoreBufferEntry *entry;
+  
+  while(n-- > 0 && sb->count > 0){
+    entry = &sb->entries[sb->head];
+    for(i = 0; i < WORD_PER_BLOCK; i++){
+      if(entry->mask & (1 << i)){
+        mem_write_32(entry->blockAddress + (i * 4), entry->words[i]);
+      }
+    }
+    sb->head = (sb->head + 1) % MAX_STORE_BUFFER;
+    sb->count--;
+    sb->drainDone = 0;
+  }
+}
+
+/************************************************************/
+/* store buffer: drain in order up to the youngest entry for this block, so memory     */
+/* is current for another core reading it                                                            */ 
+/************************************************************/
+void store_buffer_flush(StoreBuffer *sb, uint32_t blockAddress){
+  int i, last = -1;
+  for(i = 0; i < sb->count; i++){
+    if(sb->entries[(sb->head + i) % MAX_STORE_BUFFER].blockAddress == blockAddress){
+      last = i;
+    }
+  }
+  store_buffer_drain(sb, last + 1);
+}
+
+/************************************************************/
+/* store buffer: overlay stores not yet in memory onto a block just read from it       */ 
+/************************************************************/
+void store_buffer_forward(uint32_t blockAddress, uint32_t *words){
+  int i, j, forwarded = FALSE;
+  StoreBufferEntry *entry;
   
+  for(i = 0; i < storeBuffer.count; i++){ //oldest first, so the youngest store wins
+    entry = &storeBuffer.entries[(storeBuffer.head + i) % MAX_STORE_BUFFER];
+    if(entry->blockAddress != blockAddress){
+      continue;
+    }
+    for(j = 0; j < WORD_PER_BLOCK; j++){
+      if(entry->mask & (1 << j)){
+        words[j] = entry->words[j];
+        forwarded = TRUE;
+      }
+    }
+  }
+  if(forwarded){
+    store_buffer_forwards++;
+  }
+}
+
+/************************************************************/
+/* LIBRARY API (mumips.h)                                                                                */ 
+/************************************************************/
+struct mumips_sim {
+	int core; //core the API thread drives, always 0
+};
+
+static mumips_sim SIMULATOR;
+static int SIMULATOR_EXISTS = FALSE;
+
+/* until() callback of mumips_run_until() with its simulator handle */
+typedef struct Until_Struct {
+	mumips_sim *sim;
+	int (*until)(mumips_sim *, void *);
+	void *arg;
+} Until;
+
+static int call_until(void *arg)
+{
+	Until *u = arg;
+	return u->until(u->sim, u->arg);
+}
+
+/************************************************************/
+/* put every setting back to what the simulator starts with                                      */ 
+/************************************************************/
+static void default_config()
+{
+	ENABLE_FORWARDING = FALSE;
+	ISSUE_WIDTH = 1;
+	OOO_MODE = FALSE;
+	OOO_ROB_SIZE = 64;
+	OOO_WIDTH = 2;
+	OOO_LSQ_SIZE = 16;
+	OOO_MSHRS = 4;
+	OOO_RS_SIZE[FU_ALU] = 16;
+	OOO_RS_SIZE[FU_MULDIV] = 4;
+	OOO_RS_SIZE[FU_LS] = 16;
+	OOO_UNITS[FU_ALU] = 2;
+	OOO_UNITS[FU_MULDIV] = 1;
+	OOO_UNITS[FU_LS] = 1;
+	OOO_LATENCY[FU_ALU] = 1;
+	OOO_LATENCY[FU_MULDIV] = 4;
+	OOO_LATENCY[FU_LS] = 1;
+	PREFETCH_MODE = PREFETCH_OFF;
+	PREFETCH_DEGREE = 1;
+	PREFETCH_DISTANCE = 1;
+	VICTIM_ENTRIES = 0;
+	VICTIM_HIT_PENALTY = 2;
+	FILL_MODE = FILL_WHOLE_BLOCK;
+	FILL_BEAT_CYCLES = 8;
+	MMU_MODE = MMU_OFF;
+	TLB_REFILL_CYCLES = 20;
+	TLB_ENTRIES[ITLB] = 16;
+	TLB_WAYS[ITLB] = 4;
+	TLB_ENTRIES[DTLB] = 32;
+	TLB_WAYS[DTLB] = 4;
+	SPM_ON = FALSE;
+	SPM_BEGIN = SPM_DEFAULT_BEGIN;
+	SPM_SIZE = SPM_DEFAULT_SIZE;
+	DMA_SETUP_CYCLES = 20;
+	DMA_WORD_CYCLES = 2;
+	STORE_BUFFER_SIZE = 4;
+	STORE_DRAIN_CYCLES = 4;
+	CYCLE_SKIPPING = TRUE;
+	CORE_QUANTUM = 100;
+	BREAKPOINT_COUNT = 0;
+	memset(WATCHPOINTS, 0, sizeof(WATCHPOINTS));
+	WATCHPOINT_COUNT = 0;
+	DEBUG_STOP = FALSE;
+	CHECKING = FALSE;
+	CHECK_BATCH = 1024;
+	SAMPLE_PERIOD = 0;
+	SAMPLE_WARMUP = 2000;
+	SAMPLE_WINDOW = 1000;
+	SAMPLE_WARM_CACHE = TRUE;
+	PROFILE_TOP = PROFILE_DEFAULT_TOP;
+	REUSE_ON = FALSE;
+	REUSE_WINDOW = 10000;
+	CLASSIFY_MISSES = FALSE;
+	snprintf(LOG_FILE, sizeof(LOG_FILE), "%s", LOG_DEFAULT_FILE);
+	BRANCH_IN_ID = FALSE;
+	DELAY_SLOT = FALSE;
+}
+
+/************************************************************/
+/* memory word as the program sees it: stores still in a store buffer win               */ 
+/************************************************************/
+uint32_t mem_read_visible(uint32_t address)
+{
+	int i, j;
+	uint32_t value = mem_read_32(address);
+	StoreBuffer *sb;
+	StoreBufferEntry *entry;
+	
+	for (i = 0; i < CORE_COUNT; i++){
+		sb = CORES[i].storeBuffer;
+		for (j = 0; j < sb->count; j++){ //oldest first
+			entry = &sb->entries[(sb->head + j) % MAX_STORE_BUFFER];
+			if (entry->blockAddress == CACHE_BLOCK_ADDRESS(address) && (entry->mask & (1 << CACHE_WORD_OFFSET(address)))){
+				value = entry->words[CACHE_WORD_OFFSET(address)];
+			}
+		}
+	}
+	return value;
+}
+
+/************************************************************/
+/* write a word behind the program's back: memory, every cached copy, and drop    */
+/* buffered stores that would overwrite it later                                                        */ 
+/************************************************************/
+void mem_write_visible(uint32_t address, uint32_t value)
+{
+	int i, j;
+	Cache *cache;
+	StoreBuffer *sb;
+	StoreBufferEntry *entry;
+	
+	mem_write_32(address, value);
+	if (CHECKING && REF_MEMORY[address >> REF_PAGE_SHIFT] != NULL){
+		ref_write(address & ~3, value, 4); //the reference sees it too
+	}
+	for (i = 0; i < CORE_COUNT; i++){
+		cache = CORES[i].cache;
+		if (cache->blocks[CACHE_INDEX(address)].valid && cache->blocks[CACHE_INDEX(address)].tag == CACHE_TAG(address)){
+			cache->blocks[CACHE_INDEX(address)].words[CACHE_WORD_OFFSET(address)] = value;
+		}
+		j = victim_find(cache, CACHE_BLOCK_ADDRESS(address));
+		if (j >= 0){
+			cache->victims[j].block.words[CACHE_WORD_OFFSET(address)] = value;
+		}
+		sb = CORES[i].storeBuffer;
+		for (j = 0; j < sb->count; j++){
+			entry = &sb->entries[(sb->head + j) % MAX_STORE_BUFFER];
+			if (entry->blockAddress == CACHE_BLOCK_ADDRESS(address)){
+				entry->mask &= ~(1 << CACHE_WORD_OFFSET(address));
+			}
+		}
+	}
+}
+
+mumips_sim *mumips_create(void)
+{
+	if (SIMULATOR_EXISTS){
+		return NULL;
+	}
+	SIMULATOR_EXISTS = TRUE;
+	SIMULATOR.core = 0;
+	default_config();
+	PROGRAM_SIZE = 0;
+	prog_file[0] = '\0';
+	initialize();
+	reset_core();
+	return &SIMULATOR;
+}
+
+void mumips_destroy(mumips_sim *sim)
+{
+	int i;
+	
+	if (sim != &SIMULATOR || !SIMULATOR_EXISTS){
+		return;
+	}
+	stop_cores();
+	log_stop();
+	memset(LOG_LEVELS, 0, sizeof(LOG_LEVELS));
+	//analysis buffers, so the next simulator starts with nothing switched on
+	set_profiling(FALSE, PROFILE_DEFAULT_TOP);
+	set_reuse(FALSE, REUSE_WINDOW);
+	set_classify_misses(FALSE);
+	free(SEEN_PAGES);
+	SEEN_PAGES = NULL;
+	if (REF_MEMORY != NULL){
+		for (i = 0; i < REF_NUM_PAGES; i++){
+			free(REF_MEMORY[i]);
+		}
+		free(REF_MEMORY);
+		REF_MEMORY = NULL;
+	}
+	free(WATCH_PAGES);
+	WATCH_PAGES = NULL;
+	for (i = 0; i < NUM_MEM_REGION; i++){
+		free(MEM_REGIONS[i].mem);
+		MEM_REGIONS[i].mem = NULL;
+	}
+	free(PROGRAM_IMAGE);
+	PROGRAM_IMAGE = NULL;
+	PROGRAM_SIZE = 0;
+	SIMULATOR_EXISTS = FALSE;
+}
+
+int mumips_load(mumips_sim *sim, const uint32_t *words, size_t count)
+{
+	if (sim != &SIMULATOR){
+		return -1;
+	}
+	PROGRAM_IMAGE = realloc(PROGRAM_IMAGE, (count ? count : 1) * sizeof(uint32_t));
+	memcpy(PROGRAM_IMAGE, words, count * sizeof(uint32_t));
+	PROGRAM_SIZE = count;
+	prog_file[0] = '\0';
+	reset();
+	return 0;
+}
+
+int mumips_load_file(mumips_sim *sim, const char *path)
+{
+	if (sim != &SIMULATOR || strlen(path) >= sizeof(prog_file)){
+		return -1;
+	}
+	strcpy(prog_file, path);
+	if (load_program() != 0){
+		return -1;
+	}
+	reset();
+	return 0;
+}
+
+uint32_t mumips_step(mumips_sim *sim, uint32_t cycles)
+{
+	return simulate(cycles, NULL, NULL);
+}
+
+uint32_t mumips_run_until(mumips_sim *sim, int (*until)(mumips_sim *, void *), void *arg, uint32_t max_cycles)
+{
+	Until u;
+	
+	if (until == NULL){
+		return simulate(max_cycles, NULL, NULL);
+	}
+	u.sim = sim;
+	u.until = until;
+	u.arg = arg;
+	return simulate(max_cycles, call_until, &u);
+}
+
+int mumips_running(mumips_sim *sim)
+{
+	return any_core_running();
+}
+
+int mumips_exit_code(mumips_sim *sim)
+{
+	return EXIT_CODE;
+}
+
+void mumips_read_regs(mumips_sim *sim, int first, int count, uint32_t *values)
+{
+	int i;
+	
+	if (first < 0 || count < 0){
+		return;
+	}
+	for (i = 0; i < count && first + i < MUMIPS_NUM_REGS; i++){
+		switch (first + i){
+			case MUMIPS_REG_HI: values[i] = CURRENT_STATE.HI; break;
+			case MUMIPS_REG_LO: values[i] = CURRENT_STATE.LO; break;
+			case MUMIPS_REG_PC: values[i] = CURRENT_STATE.PC; break;
+			default: values[i] = CURRENT_STATE.REGS[first + i]; break;
+		}
+	}
+}
+
+void mumips_write_regs(mumips_sim *sim, int first, int count, const uint32_t *values)
+{
+	int i;
+	
+	if (first < 0 || count < 0){
+		return;
+	}
+	//both copies, like the 'input' shell command, so ID sees the value this cycle
+	for (i = 0; i < count && first + i < MUMIPS_NUM_REGS; i++){
+		switch (first + i){
+			case MUMIPS_REG_HI: CURRENT_STATE.HI = NEXT_STATE.HI = values[i]; break;
+			case MUMIPS_REG_LO: CURRENT_STATE.LO = NEXT_STATE.LO = values[i]; break;
+			case MUMIPS_REG_PC: CURRENT_STATE.PC = NEXT_STATE.PC = values[i]; break;
+			default: CURRENT_STATE.REGS[first + i] = NEXT_STATE.REGS[first + i] = values[i]; break;
+		}
+	}
+}
+
+void mumips_read_mem(mumips_sim *sim, uint32_t address, size_t count, uint32_t *words)
+{
+	size_t i;
+	
+	for (i = 0; i < count; i++){
+		words[i] = mem_read_visible(address + (i * 4));
+	}
+}
+
+void mumips_write_mem(mumips_sim *sim, uint32_t address, size_t count, const uint32_t *words)
+{
+	size_t i;
+	
+	for (i = 0; i < count; i++){
+		mem_write_visible(address + (i * 4), words[i]);
+	}
+}
+
+void mumips_get_stats(mumips_sim *sim, mumips_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	stats->instructions = INSTRUCTION_COUNT;
+	stats->cycles = CYCLE_COUNT;
+	stats->cache_hits = cache_hits;
+	stats->cache_misses = cache_misses;
+	stats->victim_hits = victim_hits;
+	stats->prefetches_issued = prefetch_issued;
+	stats->prefetches_useful = prefetch_useful;
+	stats->stores = store_buffer_stores;
+	stats->store_buffer_full_stalls = store_buffer_full_stalls;
+	stats->skipped_cycles = SKIPPED_CYCLES;
+	stats->running = any_core_running();
+	stats->program_words = PROGRAM_SIZE;
+}
+
+uint64_t mumips_digest(mumips_sim *sim, uint64_t *registers, uint64_t *memory)
+{
+	uint64_t r = digest_registers(), m = digest_memory();
+	
+	if (registers != NULL){
+		*registers = r;
+	}
+	if (memory != NULL){
+		*memory = m;
+	}
+	return digest_mix(r ^ digest_mix(m));
+}
+
+int mumips_command(mumips_sim *sim, const char *line)
+{
+	return handle_command(line);
 }
@@ -3,6 +3,10 @@
 #define FALSE 0
 #define TRUE  1
 
+/* one copy per simulated core (host thread), see mu-core.h. initial-exec keeps */
+/* libmumips.so (built -fPIC) on a fixed TLS offset instead of __tls_get_addr.  */
+#define CORE_LOCAL __thread __attribute__((tls_model("initial-exec")))
+
 /******************************************************************************/
 /* MIPS memory layout                                                                                                                                      */
 /******************************************************************************/
@@ -50,48 +54,112 @@ typedef struct CPU_Pipeline_Reg_Struct{
 	uint32_t IR;
 	uint32_t A;
 	uint32_t B;
-	uint32_t registerRd;
-	uint32_t registerRs;
-	uint32_t registerRt;
-	uint32_t destination;
-	uint32_t RegWrite;
 	uint32_t imm;
-	uint32_t ALUOutput;
-	uint32_t LMD;
-	uint32_t opcode;
-	uint32_t function;
-	uint32_t HI;
-	uint32_t LO;
-	int memory_reference_load, memory_reference_store, register_register, register_immediate, MULDIV;
-	int MFHI, MTHI, MFLO, MTLO;
+	union {
+		struct {
+			uint32_t ALUOutput;
+			uint32_t LMD;
+		};
+		struct { //MULT/DIV result, these never address memory
+			uint32_t LO;
+			uint32_t HI;
+		};
+	};
+	uint8_t registerRd;
+	uint8_t registerRs;
+	uint8_t registerRt;
+	uint8_t destination; //0-31, or 32 for HI/LO
+	uint8_t opcode;
+	uint8_t function;
+	uint8_t opClass; //OP_* below, set by decode_fields()
+	uint8_t resolved; //branch/jump already redirected fetch in ID, EX leaves the PC alone
+	uint8_t valid; //0 = bubble, only the flags and this are cleared in an empty latch
+	union {
+		struct {
+			uint16_t RegWrite : 1;
+			uint16_t memory_reference_load : 1;
+			uint16_t memory_reference_store : 1;
+			uint16_t register_register : 1;
+			uint16_t register_immediate : 1;
+			uint16_t MULDIV : 1;
+			uint16_t MFHI : 1;
+			uint16_t MTHI : 1;
+			uint16_t MFLO : 1;
+			uint16_t MTLO : 1;
+			uint16_t SYSCALL : 1; //exit SYSCALL, stops the simulation when it reaches WB
+			uint16_t LLSC : 1; //LL sets the link, SC stores only if the link survived and returns 1/0 in LMD
+		};
+		uint16_t control; //all of the flags above, cleared with one store
+	};
 } CPU_Pipeline_Reg;
 
+/* op classes (CPU_Pipeline_Reg.opClass) */
+#define OP_NONE 0 //bubble or NOP
+#define OP_ALU 1
+#define OP_LOAD 2 //includes LL
+#define OP_STORE 3 //includes SC
+#define OP_MULDIV 4 //MULT/DIV and the HI/LO moves
+#define OP_BRANCH 5 //branches and jumps
+#define OP_SYSCALL 6
+
 /***************************************************************/
 /* CPU State info.                                                                                                               */
 /***************************************************************/
 
-CPU_State CURRENT_STATE, NEXT_STATE;
+CORE_LOCAL CPU_State CURRENT_STATE, NEXT_STATE;
 int ENABLE_FORWARDING = FALSE; //Data forwarding flag
-int FORWARD_A = 0; //Flag for RS forward	01 From MEM, 10 From EX (decimal)
-int FORWARD_B = 0; //Flag for RT forward	01 From MEM, 10 From EX (decimal)
-int RUN_FLAG;	/* run flag*/
-uint32_t INSTRUCTION_COUNT;
-uint32_t CYCLE_COUNT;
+int ISSUE_WIDTH = 1; //1 = scalar pipeline, 2 = dual-issue in-order pipeline
+CORE_LOCAL int RUN_FLAG;	/* run flag*/
+CORE_LOCAL uint32_t INSTRUCTION_COUNT;
+CORE_LOCAL uint32_t CYCLE_COUNT;
 uint32_t PROGRAM_SIZE; /*in words*/
+uint32_t *PROGRAM_IMAGE; /*the loaded program, written back into memory by reset()*/
 
 
 
 /***************************************************************/
 /* Pipeline Registers.                                                                                                        */
 /***************************************************************/
-CPU_Pipeline_Reg IF_ID;
-CPU_Pipeline_Reg ID_EX;
-CPU_Pipeline_Reg EX_MEM;
-CPU_Pipeline_Reg MEM_WB;
+CORE_LOCAL CPU_Pipeline_Reg IF_ID;
+CORE_LOCAL CPU_Pipeline_Reg ID_EX;
+CORE_LOCAL CPU_Pipeline_Reg EX_MEM;
+CORE_LOCAL CPU_Pipeline_Reg MEM_WB;
+
+/* Second issue slot, only used when ISSUE_WIDTH == 2. It always holds the younger instruction of the pair. */
+CORE_LOCAL CPU_Pipeline_Reg IF_ID_2;
+CORE_LOCAL CPU_Pipeline_Reg ID_EX_2;
+CORE_LOCAL CPU_Pipeline_Reg EX_MEM_2;
+CORE_LOCAL CPU_Pipeline_Reg MEM_WB_2;
+
+char prog_file[256];
+CORE_LOCAL int stalling = 0;
+CORE_LOCAL int cacheStalling = 0;
+
+/* Branch resolution: in EX (default) or in ID with its own comparator, optionally with the MIPS delay slot */
+int BRANCH_IN_ID = FALSE;
+int DELAY_SLOT = FALSE;
+CORE_LOCAL int delaySlotPending; //taken branch waits for its delay slot to be fetched
+CORE_LOCAL uint32_t delaySlotTarget;
+CORE_LOCAL int branchBubble; //IF skips this cycle, the sequential fetch is on the wrong path
+CORE_LOCAL int resolvingInID; //execute() only reports the redirect (branchTaken/branchTarget)
+CORE_LOCAL int branchTaken;
+CORE_LOCAL uint32_t branchTarget;
+CORE_LOCAL uint32_t BRANCH_COUNT; //branches and jumps retired
+CORE_LOCAL uint32_t BRANCH_TAKEN; //of those, redirected fetch
+
+/* Time skipping: a pipeline that is only waiting on a miss jumps to the cycle something happens */
+int CYCLE_SKIPPING = TRUE;
+CORE_LOCAL uint32_t SKIPPED_CYCLES;	//cycles advanced without calling cycle()
 
-char prog_file[32];
-int stalling = 0;
-int cacheStalling = 0;
+/***************************************************************/
+/* Dual-issue stats.                                                                                                        */
+/***************************************************************/
+CORE_LOCAL uint32_t DUAL_ISSUE_CYCLES;	//cycles where two instructions left ID together
+CORE_LOCAL uint32_t SINGLE_ISSUE_CYCLES;	//cycles where a second instruction was ready but had to wait
+CORE_LOCAL uint32_t PAIR_DEPENDENCIES;	//second instruction reads the first one's result
+CORE_LOCAL uint32_t PAIR_MEM_CONFLICTS;	//both instructions need the memory port
+CORE_LOCAL uint32_t PAIR_MULDIV_CONFLICTS;	//both instructions need the MULT/DIV unit
+CORE_LOCAL uint32_t PAIR_CONTROL_BREAKS;	//branch/jump/SYSCALL ended the issue group
 
 /***************************************************************/
 /* Function Declerations.                                                                                                */
@@ -100,14 +168,17 @@ void help();
 uint32_t mem_read_32(uint32_t address);
 void mem_write_32(uint32_t address, uint32_t value);
 void cycle();
+int cycle_skip(int limit);
 void run(int num_cycles);
 void runAll();
+uint32_t simulate(uint32_t num_cycles, int (*until)(void *), void *arg);
 void mdump(uint32_t start, uint32_t stop) ;
 void rdump();
-void handle_command();
+int handle_command(const char *line);
 void reset();
 void init_memory();
-void load_program();
+int load_program();
+void write_program();
 void handle_pipeline(); /*IMPLEMENT THIS*/
 void WB();/*IMPLEMENT THIS*/
 void MEM();/*IMPLEMENT THIS*/
@@ -119,6 +190,36 @@ void initialize();
 void print_program(); /*IMPLEMENT THIS*/
 void print_instruction(uint32_t);
 void flush();
-void writeBufferToMemory(uint32_t);                                                                                
+void writeback(CPU_Pipeline_Reg *);
+void retire(CPU_Pipeline_Reg *);
+void execute(CPU_Pipeline_Reg *);
+int decode(CPU_Pipeline_Reg *, CPU_Pipeline_Reg *);
+void decode_fields(CPU_Pipeline_Reg *);
+void fetch(CPU_Pipeline_Reg *);
+int read_operand(uint32_t, uint32_t *);
+int control_in_EX();
+int redirects_in_EX(CPU_Pipeline_Reg *);
+int is_branch(uint32_t);
+uint8_t op_class(uint32_t);
+void latch_clear(CPU_Pipeline_Reg *);
+void redirect(CPU_Pipeline_Reg *, uint32_t);
+void take_delayed_branch();
+void resolve_in_ID(CPU_Pipeline_Reg *);
+int branch_operand_pending(uint32_t, uint32_t);
+int is_control(uint32_t);
+int is_memory_op(uint32_t);
+int is_muldiv(uint32_t);
+uint32_t instruction_dest(uint32_t);
+int instruction_reads(uint32_t, uint32_t);
+int can_pair(uint32_t, uint32_t);
+void data_access(CPU_Pipeline_Reg *);
+CPU_Pipeline_Reg *memory_slot();
+void cache_access(CPU_Pipeline_Reg *);
+void cache_fill(CPU_Pipeline_Reg *);
+void cache_load(CPU_Pipeline_Reg *);
+void cache_store(CPU_Pipeline_Reg *);
+void print_stats();
+void set_issue_width(int);
+void configure_branches(int, int);                                                                                
                                                                                 
 
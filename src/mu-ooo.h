@@ -0,0 +1,100 @@
+/******************************************************************************/
+/* OUT-OF-ORDER CORE MODEL                                                    */
+/******************************************************************************/
+/* Alternative to handle_pipeline(). Instructions are executed functionally, */
+/* in program order, when they are dispatched; the ROB, reservation stations, */
+/* load/store queue and MSHRs below only decide *when* each one completes.    */
+/******************************************************************************/
+#define MAX_ROB_SIZE 256
+#define MAX_MSHRS 16
+#define OOO_NUM_REGS 34 //32 GPRs + HI + LO
+#define OOO_REG_HI 32
+#define OOO_REG_LO 33
+
+/* functional unit classes, each one with its own reservation station */
+#define FU_ALU 0
+#define FU_MULDIV 1
+#define FU_LS 2
+#define NUM_FU_CLASSES 3
+
+typedef struct ROB_Entry_Struct {
+
+  uint32_t seq; //dispatch order, tells a reused slot from the producer it replaced
+  uint32_t PC;
+  uint32_t IR;
+  int fu;
+  int numSources;
+  int srcIndex[3]; //ROB slot of the producer of each source (register renaming), -1 if it was in the register file
+  uint32_t srcSeq[3];
+  int numDests;
+  int destReg[2]; //architectural registers this entry renames (HI/LO count as registers)
+  int issued;
+  uint32_t readyCycle; //cycle the result is available to dependents
+  int load, store, control, exitSyscall;
+  int forwarded; //load gets its data from an older in-flight store (last source)
+  uint32_t address;
+
+} ROB_Entry;
+
+typedef struct MSHR_Struct {
+
+  int valid;
+  uint32_t blockAddress;
+  uint32_t fillCycle; //cycle the block arrives in L1Cache
+
+} MSHR;
+
+/***************************************************************/
+/* OoO CONFIGURATION                                           */
+/***************************************************************/
+int OOO_MODE = FALSE;
+int OOO_ROB_SIZE = 64;
+int OOO_WIDTH = 2; //dispatch, issue and commit width
+int OOO_LSQ_SIZE = 16;
+int OOO_MSHRS = 4; //outstanding L1 misses
+int OOO_RS_SIZE[NUM_FU_CLASSES] = { 16, 4, 16 };
+int OOO_UNITS[NUM_FU_CLASSES] = { 2, 1, 1 }; //ALU units follow OOO_WIDTH, one MULT/DIV unit and one memory port
+uint32_t OOO_LATENCY[NUM_FU_CLASSES] = { 1, 4, 1 }; //memory latency is the L1 hit time
+
+/***************************************************************/
+/* OoO STATE                                                   */
+/***************************************************************/
+ROB_Entry ROB[MAX_ROB_SIZE];
+int robHead, robCount;
+uint32_t robSeq;
+int ratIndex[OOO_NUM_REGS]; //register alias table, -1 means the value is in the register file
+uint32_t ratSeq[OOO_NUM_REGS];
+int rsUsed[NUM_FU_CLASSES];
+int lsqUsed;
+MSHR MSHRS[MAX_MSHRS];
+int frontendBlocked; //ROB slot + 1 of an unresolved branch/jump, fetch waits for it like ID does in the pipeline
+uint32_t frontendBlockSeq;
+int frontendHalted; //exit SYSCALL dispatched, nothing after it may execute
+
+/***************************************************************/
+/* OoO STATS                                                   */
+/***************************************************************/
+uint32_t OOO_ROB_FULL_STALLS;
+uint32_t OOO_RS_FULL_STALLS;
+uint32_t OOO_LSQ_FULL_STALLS;
+uint32_t OOO_MSHR_FULL_STALLS;
+uint32_t OOO_MSHR_MERGES; //misses to a block that was already being fetched
+uint32_t OOO_STORE_FORWARDS;
+uint64_t OOO_ROB_OCCUPANCY; //summed every cycle
+uint64_t OOO_MISSES_OUTSTANDING; //summed over cycles with at least one miss outstanding
+uint32_t OOO_MISS_CYCLES;
+
+/***************************************************************/
+/* OoO Function Declerations.                                  */
+/***************************************************************/
+void handle_ooo();
+int ooo_done(ROB_Entry *);
+int ooo_source_ready(ROB_Entry *, int);
+void ooo_commit();
+void ooo_fill();
+int ooo_cache_access(ROB_Entry *);
+void ooo_issue();
+void ooo_dispatch();
+void ooo_reset();
+void set_ooo_mode(int);
+void configure_ooo(int, int, int, int, int);
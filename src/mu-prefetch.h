@@ -0,0 +1,65 @@
+/******************************************************************************/
+/* HARDWARE DATA PREFETCHER                                                   */
+/******************************************************************************/
+/* Trained on demand accesses in MEM(). Predicted blocks are fetched in the  */
+/* background and installed in L1Cache CACHE_MISS_PENALTY cycles later,       */
+/* without stalling the pipeline.                                             */
+/******************************************************************************/
+#define PREFETCH_OFF 0
+#define PREFETCH_NEXT_LINE 1 //next-N-line, triggered by a miss or the first use of a prefetched block
+#define PREFETCH_STRIDE 2    //PC-indexed reference prediction table
+
+#define PREFETCH_QUEUE_SIZE 16 //prefetches in flight
+#define STRIDE_TABLE_SIZE 64
+#define STRIDE_CONFIDENT 2 //same stride seen this many times in a row before prefetching
+
+typedef struct Prefetch_Struct {
+
+  int valid;
+  uint32_t blockAddress;
+  uint32_t readyCycle;
+
+} Prefetch;
+
+typedef struct Stride_Entry_Struct {
+
+  uint32_t PC;
+  uint32_t lastAddress;
+  int32_t stride;
+  int confidence;
+
+} Stride_Entry;
+
+/***************************************************************/
+/* PREFETCH CONFIGURATION                                      */
+/***************************************************************/
+int PREFETCH_MODE = PREFETCH_OFF;
+int PREFETCH_DEGREE = 1;   //blocks prefetched per trigger
+int PREFETCH_DISTANCE = 1; //how far ahead the first one is, in blocks (next-line) or strides (stride)
+
+/***************************************************************/
+/* PREFETCH STATE                                              */
+/***************************************************************/
+CORE_LOCAL Prefetch prefetchQueue[PREFETCH_QUEUE_SIZE];
+CORE_LOCAL Stride_Entry strideTable[STRIDE_TABLE_SIZE];
+CORE_LOCAL uint32_t pollutedTag[NUM_CACHE_BLOCKS]; //demand block a prefetch evicted from each set, + 1 (0 = none)
+CORE_LOCAL uint32_t missLatency; //cycles the current demand miss stalls for
+
+/***************************************************************/
+/* PREFETCH STATS                                              */
+/***************************************************************/
+CORE_LOCAL uint32_t prefetch_issued;
+CORE_LOCAL uint32_t prefetch_useful;    //prefetched block later hit by a demand access
+CORE_LOCAL uint32_t prefetch_late;      //demand miss caught the prefetch still in flight
+CORE_LOCAL uint32_t prefetch_useless;   //prefetched block evicted before it was used
+CORE_LOCAL uint32_t prefetch_polluting; //demand miss on a block a prefetch had evicted
+
+/***************************************************************/
+/* Prefetch Function Declerations.                             */
+/***************************************************************/
+void prefetch_train(uint32_t, uint32_t, int);
+void prefetch_issue(uint32_t);
+void prefetch_tick();
+int prefetch_in_flight(uint32_t);
+void prefetch_reset();
+void configure_prefetch(int, int, int);
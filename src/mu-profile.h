@@ -0,0 +1,52 @@
+/******************************************************************************/
+/* GUEST HOT-SPOT PROFILER                                                    */
+/******************************************************************************/
+/* One counter entry per text word, indexed by (PC - MEM_TEXT_BEGIN)/4:      */
+/* times the instruction retired, cycles the pipeline stalled on it (its    */
+/* miss in MEM, an operand it waits for in ID, or fetch waiting for it to    */
+/* redirect) and the D-cache misses it made. The hooks cost one NULL test   */
+/* while profiling is off. Only core 0 is profiled.                          */
+/******************************************************************************/
+#define PROFILE_DEFAULT_TOP 10
+
+typedef struct Profile_Entry_Struct {
+
+  uint32_t count;
+  uint32_t stalls;
+  uint32_t misses;
+
+} Profile_Entry;
+
+typedef struct Profile_Block_Struct {
+
+  uint32_t start, end; //first and last instruction
+  uint32_t entries; //times the first instruction retired
+  uint32_t instructions, stalls, misses; //summed over the block
+
+} Profile_Block;
+
+/***************************************************************/
+/* PROFILER STATE                                              */
+/***************************************************************/
+Profile_Entry *PROFILE_DATA = NULL; //PROFILE_SIZE entries while profiling, NULL otherwise
+uint32_t PROFILE_SIZE;
+int PROFILE_TOP = PROFILE_DEFAULT_TOP;
+
+#define PROFILE_INDEX(pc) (((pc) - MEM_TEXT_BEGIN) >> 2)
+#define PROFILE_ADD(pc, field, n) do { \
+  if (PROFILE_DATA != NULL && CORE_ID == 0 && PROFILE_INDEX(pc) < PROFILE_SIZE) PROFILE_DATA[PROFILE_INDEX(pc)].field += (n); \
+} while (0)
+#define PROFILE_RETIRE(pc) PROFILE_ADD(pc, count, 1)
+#define PROFILE_STALL(pc, n) PROFILE_ADD(pc, stalls, n)
+#define PROFILE_MISS(pc) PROFILE_ADD(pc, misses, 1)
+
+/***************************************************************/
+/* Profiler Function Declerations.                             */
+/***************************************************************/
+void set_profiling(int, int);
+void profile_reset();
+int profile_compare(const void *, const void *);
+int profile_block_compare(const void *, const void *);
+void print_profile();
+void print_profile_blocks();
+void profile_leaders(uint8_t *);
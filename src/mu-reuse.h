@@ -0,0 +1,68 @@
+/******************************************************************************/
+/* REUSE-DISTANCE AND WORKING-SET ANALYZER                                    */
+/******************************************************************************/
+/* Every data access in MEM() is reduced to its block address. Its reuse    */
+/* distance is the number of distinct blocks touched since the same block   */
+/* was last touched, i.e. the smallest fully-associative LRU cache that      */
+/* would hit. Each block's latest access time is marked in a Fenwick tree,  */
+/* so a distance is two prefix sums (O(log n)). When the timeline fills up  */
+/* the marks are renumbered 0..blocks-1, so memory only grows with the      */
+/* number of distinct blocks, never with the number of accesses.             */
+/******************************************************************************/
+#define REUSE_BUCKETS 33 //distance 0, then 1, 2-3, 4-7, ... up to 2^31 and above
+#define REUSE_MIN_TIMELINE (1 << 16)
+#define REUSE_MIN_TABLE (1 << 12)
+
+typedef struct Reuse_Slot_Struct {
+
+  int used;
+  uint32_t blockAddress;
+  uint32_t time; //timeline position of the latest access
+  uint32_t window; //working-set window (+ 1) the block was last counted in
+
+} Reuse_Slot;
+
+/***************************************************************/
+/* ANALYZER CONFIGURATION                                      */
+/***************************************************************/
+int REUSE_ON = FALSE;
+uint32_t REUSE_WINDOW = 10000; //instructions per working-set window
+
+/***************************************************************/
+/* ANALYZER STATE                                              */
+/***************************************************************/
+Reuse_Slot *reuseTable; //open addressing, block address -> slot
+uint32_t reuseTableSize;
+uint32_t *reuseTree; //Fenwick tree over the timeline, 1-based
+uint32_t reuseTreeSize;
+uint32_t reuseNow; //next timeline position
+uint32_t wsWindow, wsBlocks; //current window and the distinct blocks seen in it so far
+
+/***************************************************************/
+/* ANALYZER STATS                                              */
+/***************************************************************/
+uint64_t REUSE_HISTOGRAM[REUSE_BUCKETS];
+uint64_t REUSE_COLD; //first touch of a block
+uint64_t REUSE_ACCESSES;
+uint32_t REUSE_BLOCKS; //distinct blocks
+uint32_t WS_WINDOWS, WS_MIN, WS_MAX;
+uint64_t WS_SUM;
+
+#define REUSE_ACCESS(addr) do { \
+  if (REUSE_ON && CORE_ID == 0) reuse_access(addr); \
+} while (0)
+
+/***************************************************************/
+/* Analyzer Function Declerations.                             */
+/***************************************************************/
+void reuse_access(uint32_t);
+Reuse_Slot *reuse_slot(uint32_t);
+void reuse_grow_table();
+uint32_t reuse_prefix(uint32_t);
+void reuse_add(uint32_t, int);
+void reuse_compact();
+int reuse_time_compare(const void *, const void *);
+void reuse_window_done();
+void reuse_reset();
+void set_reuse(int, uint32_t);
+void print_reuse();
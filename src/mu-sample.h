@@ -0,0 +1,53 @@
+/******************************************************************************/
+/* SAMPLED SIMULATION (SMARTS)                                                */
+/******************************************************************************/
+/* Every SAMPLE_PERIOD instructions, SAMPLE_WARMUP instructions go through    */
+/* handle_pipeline() to warm it up, then the next SAMPLE_WINDOW are measured. */
+/* Everything in between runs untimed, one instruction per step, optionally   */
+/* keeping L1Cache warm (functional warming). CPI and the miss rate are       */
+/* estimated from the measured windows.                                       */
+/******************************************************************************/
+#define SAMPLE_FAST 0    //untimed execution
+#define SAMPLE_WARM 1    //detailed, not measured
+#define SAMPLE_MEASURE 2 //detailed, measured
+#define SAMPLE_DRAIN 3   //fetch stopped until the pipeline is empty
+
+#define SAMPLE_Z 1.96 //95% confidence
+
+/***************************************************************/
+/* SAMPLING CONFIGURATION                                      */
+/***************************************************************/
+uint32_t SAMPLE_PERIOD = 0; //instructions per sampling unit, 0 = every cycle in detail
+uint32_t SAMPLE_WARMUP = 2000;
+uint32_t SAMPLE_WINDOW = 1000;
+int SAMPLE_WARM_CACHE = TRUE; //keep L1Cache warm while fast-forwarding
+
+/***************************************************************/
+/* SAMPLING STATE                                              */
+/***************************************************************/
+int samplePhase;
+int sampleDraining; //IF() stops fetching
+uint32_t samplePhaseStart; //INSTRUCTION_COUNT the phase (or unit) started at
+uint32_t windowCycles, windowHits, windowMisses;
+
+/***************************************************************/
+/* SAMPLING STATS                                              */
+/***************************************************************/
+uint32_t SAMPLE_UNITS;
+uint32_t SAMPLE_FAST_INSTRUCTIONS;
+double sampleCPISum, sampleCPISquares;
+uint32_t sampleMissUnits; //units that made at least one cache access
+double sampleMissSum, sampleMissSquares;
+
+/***************************************************************/
+/* Sampling Function Declerations.                             */
+/***************************************************************/
+uint32_t sample_step(uint32_t);
+void sample_window_done();
+int pipeline_empty();
+void fast_step();
+void warm_cache(uint32_t, uint32_t);
+void sample_reset();
+void sample_interval(double, double, uint32_t, double *, double *);
+void print_sample_stats();
+void configure_sampling(uint32_t, uint32_t, uint32_t, int);
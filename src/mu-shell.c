@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "mumips.h"
+
+/***************************************************************/
+/* Interactive shell: reads commands and hands them to the simulator library */
+/***************************************************************/
+int main(int argc, char *argv[]) {
+	char line[256];
+	mumips_sim *sim;
+	mumips_stats stats;
+	int status;
+
+	printf("\n**************************\n");
+	printf("Welcome to MU-MIPS SIM...\n");
+	printf("**************************\n\n");
+
+	if (argc < 2) {
+		printf("Error: You should provide input file.\nUsage: %s <input program> \n\n",  argv[0]);
+		exit(1);
+	}
+
+	sim = mumips_create();
+	if (sim == NULL || mumips_load_file(sim, argv[1]) != 0) {
+		exit(1);
+	}
+	mumips_get_stats(sim, &stats);
+	printf("Program loaded into memory.\n%u words written into memory.\n\n", stats.program_words);
+	mumips_command(sim, "?");
+	while (1){
+		printf("MU-MIPS SIM:> ");
+		if (fgets(line, sizeof(line), stdin) == NULL){
+			break;
+		}
+		if (mumips_command(sim, line) == MUMIPS_QUIT){
+			break;
+		}
+	}
+	status = mumips_exit_code(sim); //lets scripts check what the guest reported
+	mumips_destroy(sim);
+	return status;
+}
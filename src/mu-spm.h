@@ -0,0 +1,69 @@
+/******************************************************************************/
+/* SCRATCHPAD AND DMA ENGINE                                                  */
+/******************************************************************************/
+/* Loads and stores inside [SPM_BEGIN, SPM_BEGIN + SPM_SIZE) skip L1Cache    */
+/* and the store buffer: MEM() serves them in its own cycle, no tag check,  */
+/* no miss. The scratchpad's contents live in the data region, so the rest  */
+/* of the simulator (checker, sampling, dumps) sees them as plain memory.   */
+/*                                                                            */
+/* The DMA engine's registers sit at DMA_BASE. Storing to DMA_CTRL starts a  */
+/* copy of DMA_LEN bytes (whole words) from DMA_SRC to DMA_DST: after       */
+/* DMA_SETUP_CYCLES one word moves every DMA_WORD_CYCLES while the pipeline  */
+/* keeps running. DMA_CTRL reads 1 while the copy is going and 0 when done,  */
+/* DMA_LEN reads the bytes still to go. Single-core pipeline only.           */
+/******************************************************************************/
+#define SPM_DEFAULT_BEGIN 0x20000000
+#define SPM_DEFAULT_SIZE 16384
+#define MAX_SPM_SIZE (1 << 20)
+
+#define DMA_BASE 0x1FFF0000
+#define DMA_SRC 0x0
+#define DMA_DST 0x4
+#define DMA_LEN 0x8
+#define DMA_CTRL 0xC
+#define DMA_END (DMA_BASE + 0x10)
+
+typedef struct DMA_Engine_Struct {
+
+  uint32_t src, dst, length; //as the guest programmed them
+  int busy;
+  uint32_t from, to, remaining; //progress of the running copy
+  uint32_t startCycle;
+  uint32_t nextCycle; //cycle the next word moves
+
+} DMA_Engine;
+
+/***************************************************************/
+/* SCRATCHPAD CONFIGURATION                                    */
+/***************************************************************/
+int SPM_ON = FALSE;
+uint32_t SPM_BEGIN = SPM_DEFAULT_BEGIN;
+uint32_t SPM_SIZE = SPM_DEFAULT_SIZE;
+uint32_t DMA_SETUP_CYCLES = 20;
+uint32_t DMA_WORD_CYCLES = 2;
+
+#define SPM_CONTAINS(addr) (SPM_ON && (addr) >= SPM_BEGIN && (addr) - SPM_BEGIN < SPM_SIZE)
+#define DMA_REGISTER(addr) (SPM_ON && (addr) >= DMA_BASE && (addr) < DMA_END)
+
+/***************************************************************/
+/* DMA STATE                                                   */
+/***************************************************************/
+DMA_Engine DMA;
+
+/***************************************************************/
+/* SCRATCHPAD STATS                                            */
+/***************************************************************/
+uint32_t SPM_LOADS, SPM_STORES;
+uint32_t DMA_TRANSFERS, DMA_WORDS;
+uint32_t DMA_BUSY_CYCLES; //start to last word, summed over finished copies
+
+/***************************************************************/
+/* Scratchpad Function Declerations.                           */
+/***************************************************************/
+void spm_access(CPU_Pipeline_Reg *);
+uint32_t dma_read(uint32_t);
+void dma_write(uint32_t, uint32_t);
+void dma_tick();
+void spm_reset();
+void configure_scratchpad(int, uint32_t, uint32_t);
+void configure_dma(int, int);
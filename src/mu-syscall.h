@@ -0,0 +1,38 @@
+/******************************************************************************/
+/* SYSCALL EMULATION (SPIM conventions)                                       */
+/******************************************************************************/
+/* $v0 selects the service, $a0 is the argument and results come back in    */
+/* $v0. Services run when the SYSCALL executes in EX; guest output collects  */
+/* in a host buffer that goes out in one write when it fills, before input  */
+/* is read, at exit and when a run stops.                                    */
+/******************************************************************************/
+#define SYS_PRINT_INT 1
+#define SYS_PRINT_STRING 4
+#define SYS_READ_INT 5
+#define SYS_SBRK 9
+#define SYS_EXIT 10
+#define SYS_PRINT_CHAR 11
+#define SYS_READ_CHAR 12
+#define SYS_EXIT2 17 //exit with the code in $a0
+
+#define HEAP_BEGIN 0x10040000 //first address sbrk hands out, as in SPIM
+#define GUEST_OUTPUT_SIZE 4096
+#define MAX_GUEST_STRING 65536 //print_string gives up on a missing terminator after this
+
+/***************************************************************/
+/* SYSCALL STATE                                               */
+/***************************************************************/
+char GUEST_OUTPUT[GUEST_OUTPUT_SIZE];
+int guestOutputCount;
+uint32_t HEAP_END; //current program break
+int EXIT_CODE; //exit code of the guest, 0 unless it used exit2
+
+/***************************************************************/
+/* Syscall Function Declerations.                              */
+/***************************************************************/
+uint32_t syscall_emulate(uint32_t, uint32_t, int *);
+uint8_t syscall_read_byte(uint32_t);
+void guest_output(const char *, int);
+void guest_output_flush();
+int guest_input_line(char *, int);
+void syscall_reset();
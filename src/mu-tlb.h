@@ -0,0 +1,80 @@
+/******************************************************************************/
+/* MMU AND TLBS                                                               */
+/******************************************************************************/
+/* With the MMU on, IF looks up NEXT_STATE.PC in the I-TLB before fetching   */
+/* and MEM() looks up the data address in the D-TLB before the cache (or     */
+/* scratchpad). A miss stalls that stage while the entry is refilled from a  */
+/* two-level page table in kernel data (root entry, then leaf entry). Both   */
+/* reads go through the L1 like loads: a hit costs a cycle, a miss the miss  */
+/* penalty, and the block stays in the cache.                                */
+/*                                                                            */
+/* Hardware page walk: the walker reads the two entries, plus                 */
+/* TLB_REFILL_CYCLES of its own work. Nothing else happens to the pipeline.  */
+/* Software refill: the miss traps. A D-TLB miss flushes the instructions    */
+/* behind the faulting one, which are fetched again after the handler. The  */
+/* stall covers trap entry, the handler (TLB_REFILL_CYCLES of instructions  */
+/* besides its two loads) and the return, which sends the faulting           */
+/* instruction back through the front end.                                   */
+/*                                                                            */
+/* There is no OS, so the page table is never written: every walk finds the */
+/* identity mapping and only the timing is modelled. Set-associative, LRU,  */
+/* one pair of TLBs per core. Pipeline only.                                 */
+/******************************************************************************/
+#define MMU_OFF 0
+#define MMU_HARDWARE_WALK 1
+#define MMU_SOFTWARE_REFILL 2
+
+#define TLB_PAGE_SHIFT 12 //4KB pages
+#define MAX_TLB_ENTRIES MAX_WAYS
+#define ITLB 0
+#define DTLB 1
+
+/* page table: a root entry per 4MB, then a leaf entry per page in vpn order */
+#define PAGE_TABLE_ROOT 0xA0000000
+#define PAGE_TABLE_LEAVES 0xA0001000
+#define PTE_ROOT_ADDRESS(vpn) (PAGE_TABLE_ROOT + (((vpn) >> 10) << 2))
+#define PTE_LEAF_ADDRESS(vpn) (PAGE_TABLE_LEAVES + ((vpn) << 2))
+
+#define TLB_TRAP_ENTRY 3 //software refill: flush, set EPC/Cause, fetch the refill vector
+#define TLB_TRAP_EXIT 4 //software refill: ERET, faulting instruction goes through IF, ID and EX again
+
+typedef struct TLB_Struct {
+
+  TagStore vpns; //virtual page numbers, set s holds entries [s * ways, (s + 1) * ways)
+  uint32_t lastUse[MAX_TLB_ENTRIES]; //lookup number, for LRU
+  uint32_t clock;
+  uint32_t hits, misses;
+  uint32_t missCycles; //cycles spent refilling
+  uint32_t pteReads, pteMisses; //page table reads and how many missed in the L1
+  uint32_t traps; //software refill only
+
+} TLB;
+
+/***************************************************************/
+/* MMU CONFIGURATION                                           */
+/***************************************************************/
+int MMU_MODE = MMU_OFF;
+uint32_t TLB_REFILL_CYCLES = 20; //walker's own work, or the handler's instructions besides its loads
+int TLB_ENTRIES[2] = { 16, 32 }; //I-TLB, D-TLB
+int TLB_WAYS[2] = { 4, 4 };
+
+/***************************************************************/
+/* MMU STATE                                                   */
+/***************************************************************/
+CORE_LOCAL TLB TLBS[2];
+CORE_LOCAL int tlbWalking; //MEM's stall is a D-TLB miss, the access itself comes after
+CORE_LOCAL uint32_t itlbReadyCycle; //IF waits for an I-TLB refill until this cycle
+CORE_LOCAL uint32_t itlbWalkPage; //page being refilled for IF, +1 (0 = none)
+
+/***************************************************************/
+/* MMU Function Declerations.                                  */
+/***************************************************************/
+int tlb_lookup(int, uint32_t, int);
+int itlb_ready();
+uint32_t tlb_refill(int, uint32_t);
+uint32_t pte_read(int, uint32_t);
+void tlb_trap();
+void tlb_reset();
+void configure_mmu(int, int);
+void configure_tlb(int, int, int);
+void print_tlb_stats();
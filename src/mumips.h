@@ -0,0 +1,105 @@
+/******************************************************************************/
+/* MU-MIPS SIMULATOR LIBRARY (libmumips)                                      */
+/******************************************************************************/
+/* C API for driving the simulator in-process. mu-shell.c is the interactive */
+/* shell built on top of it.                                                  */
+/*                                                                            */
+/* The simulator keeps its state in globals, so only one simulator exists at */
+/* a time: create, use and destroy it before creating the next one. Calls    */
+/* must come from the thread that created it (that thread is core 0).        */
+/*                                                                            */
+/* Per-core state uses the initial-exec TLS model (about 12KB). Linking      */
+/* against libmumips.so is fine; a dlopen() of it may need static TLS room,  */
+/* e.g. GLIBC_TUNABLES=glibc.rtld.optional_static_tls=65536.                 */
+/*                                                                            */
+/* Link with -pthread -lm when using the static libmumips.a; the shared       */
+/* library already pulls both in.                                             */
+/******************************************************************************/
+#ifndef MUMIPS_H
+#define MUMIPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct mumips_sim mumips_sim;
+
+/* register numbers for mumips_read_regs/mumips_write_regs, 0..31 are the GPRs */
+#define MUMIPS_REG_HI 32
+#define MUMIPS_REG_LO 33
+#define MUMIPS_REG_PC 34
+#define MUMIPS_NUM_REGS 35
+
+/* mumips_command() result */
+#define MUMIPS_OK 0
+#define MUMIPS_QUIT 1
+
+typedef struct mumips_stats {
+
+  uint32_t instructions;
+  uint32_t cycles;
+  uint32_t cache_hits;
+  uint32_t cache_misses;
+  uint32_t victim_hits;
+  uint32_t prefetches_issued;
+  uint32_t prefetches_useful;
+  uint32_t stores;
+  uint32_t store_buffer_full_stalls;
+  uint32_t skipped_cycles;
+  int running; //program has not reached its exit SYSCALL yet
+  uint32_t program_words; //size of the loaded program
+
+} mumips_stats;
+
+/* NULL if a simulator already exists */
+mumips_sim *mumips_create(void);
+void mumips_destroy(mumips_sim *sim);
+
+/* Place a program at the start of the text segment and reset the machine. */
+/* 0 on success. Prints nothing; the loader logs a summary at LOG_INFO.      */
+int mumips_load(mumips_sim *sim, const uint32_t *words, size_t count);
+int mumips_load_file(mumips_sim *sim, const char *path);
+
+/* Simulate up to `cycles` cycles, stopping early at the exit SYSCALL or a */
+/* breakpoint/watchpoint. Returns the cycles simulated.                    */
+uint32_t mumips_step(mumips_sim *sim, uint32_t cycles);
+
+/* Simulate until until(sim, arg) returns non-zero (checked between cycles), */
+/* the program exits, a breakpoint/watchpoint fires or max_cycles pass.      */
+/* Returns the cycles simulated.                                             */
+uint32_t mumips_run_until(mumips_sim *sim, int (*until)(mumips_sim *, void *), void *arg, uint32_t max_cycles);
+
+int mumips_running(mumips_sim *sim);
+
+/* exit code of the guest: $a0 of an exit2 SYSCALL, 0 otherwise */
+int mumips_exit_code(mumips_sim *sim);
+
+/* count registers starting at first (see MUMIPS_REG_*); a negative first or */
+/* count does nothing, registers past the last one are skipped */
+void mumips_read_regs(mumips_sim *sim, int first, int count, uint32_t *values);
+void mumips_write_regs(mumips_sim *sim, int first, int count, const uint32_t *values);
+
+/* count words starting at address, as the program sees them (store buffers */
+/* and caches included); writes also update cached copies                   */
+void mumips_read_mem(mumips_sim *sim, uint32_t address, size_t count, uint32_t *words);
+void mumips_write_mem(mumips_sim *sim, uint32_t address, size_t count, const uint32_t *words);
+
+void mumips_get_stats(mumips_sim *sim, mumips_stats *stats);
+
+/* 64-bit digest of every core's GPRs/HI/LO and of memory as the program sees */
+/* it; equal digests mean equal final states. Costs time only for the pages */
+/* written since the last call. registers/memory may be NULL.               */
+uint64_t mumips_digest(mumips_sim *sim, uint64_t *registers, uint64_t *memory);
+
+/* Run one shell command line ("run 100", "prefetch 1 2 4", ...). */
+/* Returns MUMIPS_QUIT for "quit", MUMIPS_OK otherwise.            */
+int mumips_command(mumips_sim *sim, const char *line);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif